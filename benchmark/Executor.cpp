@@ -0,0 +1,128 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/Executor.cpp                                 **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/Executor.h"
+#include "utils/SynchronizedQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::function<void()> Task;
+
+// the pattern the executor replaces: all workers share one locked queue
+class QueuePool {
+public:
+  explicit QueuePool(size_t threads) : queue(65536) {
+    for (size_t i = 0; i < threads; ++i) {
+      workers.emplace_back([this]() {
+        Task task;
+        while (queue.pop(task)) {
+          task();
+        }
+      });
+    }
+  }
+
+  ~QueuePool() {
+    queue.close();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+  }
+
+  void execute(Task task) { queue.push(std::move(task)); }
+
+private:
+  canon::utils::SynchronizedQueue<Task, canon::utils::BlockProducer> queue;
+  std::vector<std::thread> workers;
+};
+
+void wait_for(const std::atomic<int> &done, int count) {
+  while (done.load() != count) {
+    std::this_thread::yield();
+  }
+}
+
+void report(const char *name, const char *pattern, int count,
+            Clock::time_point start) {
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                  .count();
+  std::printf("%-10s %-8s %8.2f ns/task\n", name, pattern, ns / count);
+}
+
+// count tiny tasks submitted from outside the pool
+template <typename Pool>
+void external(const char *name, Pool &pool, int count) {
+  std::atomic<int> done(0);
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    pool.execute([&done]() { ++done; });
+  }
+  wait_for(done, count);
+  report(name, "external", count, start);
+}
+
+// every task spawns its share of tiny tasks from inside the pool
+template <typename Pool>
+void nested(const char *name, Pool &pool, int count, size_t threads) {
+  std::atomic<int> done(0);
+  int share = count / threads;
+  Clock::time_point start = Clock::now();
+  for (size_t t = 0; t < threads; ++t) {
+    pool.execute([&pool, &done, share]() {
+      for (int i = 0; i < share; ++i) {
+        pool.execute([&done]() { ++done; });
+      }
+    });
+  }
+  wait_for(done, share * threads);
+  report(name, "nested", share * threads, start);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  size_t threads = argc > 2 ? std::atoi(argv[2])
+                            : std::max(2u, std::thread::hardware_concurrency());
+  {
+    QueuePool pool(threads);
+    external("queue", pool, count);
+    nested("queue", pool, count, threads);
+  }
+  {
+    canon::utils::Executor executor(threads);
+    external("executor", executor, count);
+    nested("executor", executor, count, threads);
+    std::atomic<int> done(0);
+    std::vector<Task> tasks(count, [&done]() { ++done; });
+    Clock::time_point start = Clock::now();
+    executor.execute_range(tasks.begin(), tasks.end());
+    wait_for(done, count);
+    report("executor", "range", count, start);
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/SpscQueue.cpp                                **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SpscQueue.h"
+#include "utils/SynchronizedQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// one producer pushes count increasing values, one consumer pops until it
+// sees the last one. the last value can never be overwritten.
+template <typename Queue>
+void run(const char *name, size_t capacity, int count) {
+  Queue queue(capacity);
+  size_t received = 0;
+  Clock::time_point start = Clock::now();
+  std::thread consumer([&queue, &received, count]() {
+    int value = -1;
+    while (value != count - 1) {
+      queue.pop(value);
+      ++received;
+    }
+  });
+  for (int i = 0; i < count; ++i) {
+    queue.push(i);
+  }
+  consumer.join();
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                  .count();
+  std::printf("%-20s capacity %6zu: %8.2f ns/element, %zu of %d received\n",
+              name, capacity, ns / count, received, count);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000000;
+  for (size_t capacity : {16, 1024, 65536}) {
+    run<canon::utils::SynchronizedQueue<int>>("SynchronizedQueue", capacity,
+                                              count);
+    run<canon::utils::SpscQueue<int>>("SpscQueue", capacity, count);
+  }
+  return 0;
+}
@@ -0,0 +1,111 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/Subject.cpp                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/Subject.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+void report(const char *name, size_t subscribers, size_t threads, int count,
+            Clock::time_point start) {
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                  .count();
+  std::printf("%-15s %3zu subscribers %2zu threads %8.2f ns/notify\n", name,
+              subscribers, threads, ns / count);
+}
+
+// count notifications per thread to a subject with the given subscribers
+template <typename Engine>
+void run(const char *name, size_t subscribers, size_t threads, int count) {
+  canon::utils::Subject<int, Engine> subject;
+  std::atomic<long> sum(0);
+  for (size_t i = 0; i < subscribers; ++i) {
+    subject.connect([&sum](int data) {
+      sum.fetch_add(data, std::memory_order_relaxed);
+    });
+  }
+  std::vector<std::thread> notifiers;
+  Clock::time_point start = Clock::now();
+  for (size_t t = 0; t < threads; ++t) {
+    notifiers.emplace_back([&subject, count]() {
+      for (int i = 0; i < count; ++i) {
+        subject.notify(1);
+      }
+    });
+  }
+  for (auto &notifier : notifiers) {
+    notifier.join();
+  }
+  report(name, subscribers, threads, count * threads, start);
+}
+
+// notifications spread over sources merged into one subject
+template <typename Merge, typename Engine>
+void merge(const char *name, size_t sources, int count) {
+  std::vector<typename canon::utils::Subject<int, Engine>::Ptr> leaves;
+  for (size_t i = 0; i < sources; ++i) {
+    leaves.push_back(std::make_shared<canon::utils::Subject<int, Engine>>());
+  }
+  Merge merged(leaves);
+  long sum = 0;
+  merged.connect([&sum](int data) { sum += data; });
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    leaves[i % sources]->notify(1);
+  }
+  report(name, 1, 1, count, start);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  size_t threads = argc > 2 ? std::atoi(argv[2])
+                            : std::max(2u, std::thread::hardware_concurrency());
+  for (size_t subscribers : {1, 4, 16}) {
+    run<canon::utils::Signals2>("signals2", subscribers, 1, count);
+    run<canon::utils::CopyOnWrite>("copyonwrite", subscribers, 1, count);
+    // single threaded only
+    run<canon::utils::Unsynchronized>("unsynchronized", subscribers, 1, count);
+    run<canon::utils::Signals2>("signals2", subscribers, threads, count);
+    run<canon::utils::CopyOnWrite>("copyonwrite", subscribers, threads, count);
+  }
+  using canon::utils::CompositeSubject;
+  using canon::utils::MergedSubject;
+  using canon::utils::Signals2;
+  using canon::utils::CopyOnWrite;
+  merge<CompositeSubject<int, Signals2>, Signals2>("composite", 4, count);
+  merge<MergedSubject<int, Signals2>, Signals2>("merged", 4, count);
+  merge<CompositeSubject<int, CopyOnWrite>, CopyOnWrite>("composite-cow", 4,
+                                                         count);
+  merge<MergedSubject<int, CopyOnWrite>, CopyOnWrite>("merged-cow", 4, count);
+  using canon::utils::Unsynchronized;
+  merge<CompositeSubject<int, Unsynchronized>, Unsynchronized>(
+      "composite-un", 4, count);
+  merge<MergedSubject<int, Unsynchronized>, Unsynchronized>("merged-un", 4,
+                                                            count);
+  return 0;
+}
@@ -0,0 +1,91 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/SynchronizedQueueBatch.cpp                   **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SynchronizedQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef canon::utils::SynchronizedQueue<int> Queue;
+
+// the producer pushes count increasing values in batches of batch_size, the
+// consumer pops until it sees the last one. returns consumer lock round-trips.
+template <typename Consume>
+void run(const char *name, int count, size_t batch_size, Consume consume) {
+  Queue queue(4096);
+  size_t received = 0;
+  size_t calls = 0;
+  Clock::time_point start = Clock::now();
+  std::thread consumer([&]() {
+    std::vector<int> values;
+    while (values.empty() || values.back() != count - 1) {
+      values.clear();
+      consume(queue, values);
+      received += values.size();
+      ++calls;
+    }
+  });
+  std::vector<int> batch;
+  for (int i = 0; i < count;) {
+    batch.clear();
+    for (size_t b = 0; b < batch_size && i < count; ++b, ++i) {
+      batch.push_back(i);
+    }
+    if (batch_size == 1) {
+      queue.push(batch.front());
+    } else {
+      queue.push_range(batch.begin(), batch.end());
+    }
+  }
+  consumer.join();
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                  .count();
+  std::printf("%-10s push batch %4zu: %8.2f ns/element, %9zu pop calls for "
+              "%9zu elements\n",
+              name, batch_size, ns / count, calls, received);
+}
+
+void pop(Queue &queue, std::vector<int> &values) {
+  int value = 0;
+  queue.pop(value);
+  values.push_back(value);
+}
+
+void pop_bulk(Queue &queue, std::vector<int> &values) {
+  queue.pop_bulk(std::back_inserter(values), 256);
+}
+
+void drain(Queue &queue, std::vector<int> &values) { queue.drain(values); }
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000000;
+  for (size_t batch_size : {1, 64}) {
+    run("pop", count, batch_size, pop);
+    run("pop_bulk", count, batch_size, pop_bulk);
+    run("drain", count, batch_size, drain);
+  }
+  return 0;
+}
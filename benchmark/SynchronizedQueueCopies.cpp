@@ -0,0 +1,90 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/SynchronizedQueueCopies.cpp                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SynchronizedQueue.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// a message that counts the payload bytes it copies
+struct Frame {
+  static size_t copied;
+  std::vector<char> payload;
+
+  Frame() = default;
+  explicit Frame(size_t bytes) : payload(bytes) {}
+  Frame(const Frame &other) : payload(other.payload) {
+    copied += payload.size();
+  }
+  Frame(Frame &&other) = default;
+  Frame &operator=(const Frame &other) {
+    payload = other.payload;
+    copied += payload.size();
+    return *this;
+  }
+  Frame &operator=(Frame &&other) = default;
+};
+size_t Frame::copied = 0;
+
+typedef canon::utils::SynchronizedQueue<Frame> Queue;
+
+template <typename Push>
+void run(const char *name, size_t bytes, int count, Push push) {
+  Queue queue(16);
+  Frame dst;
+  Frame::copied = 0;
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    push(queue, bytes);
+    queue.pop(dst);
+  }
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - start)
+                  .count();
+  std::printf("%-12s %8zu bytes: %10.1f bytes copied/message, %10.1f "
+              "ns/message\n",
+              name, bytes, double(Frame::copied) / count, ns / count);
+}
+
+void push_copy(Queue &queue, size_t bytes) {
+  Frame frame(bytes);
+  queue.push(frame);
+}
+
+void push_move(Queue &queue, size_t bytes) {
+  Frame frame(bytes);
+  queue.push(std::move(frame));
+}
+
+void emplace(Queue &queue, size_t bytes) { queue.emplace(bytes); }
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+  for (size_t bytes : {100, 64 * 1024, 8 * 1024 * 1024}) {
+    run("push(const&)", bytes, count, push_copy);
+    run("push(&&)", bytes, count, push_move);
+    run("emplace", bytes, count, emplace);
+  }
+  return 0;
+}
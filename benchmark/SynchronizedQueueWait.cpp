@@ -0,0 +1,72 @@
+/********************************************************************
+**                                                                 **
+** File   : benchmark/SynchronizedQueueWait.cpp                    **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SynchronizedQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef canon::utils::SynchronizedQueue<Clock::time_point> Queue;
+
+// the producer pushes its current time every interval, the consumer records
+// how long each element took from push to the return of pop
+void run(const char *name, canon::utils::WaitStrategy wait, int count,
+         std::chrono::microseconds interval) {
+  Queue queue(16, canon::utils::DropOldest(), wait);
+  std::vector<double> latencies;
+  latencies.reserve(count);
+  std::thread consumer([&]() {
+    Clock::time_point pushed;
+    for (int i = 0; i < count; ++i) {
+      queue.pop(pushed);
+      latencies.push_back(
+          std::chrono::duration<double, std::micro>(Clock::now() - pushed)
+              .count());
+    }
+  });
+  for (int i = 0; i < count; ++i) {
+    Clock::time_point next = Clock::now() + interval;
+    queue.push(Clock::now());
+    while (Clock::now() < next) {
+      std::this_thread::yield();
+    }
+  }
+  consumer.join();
+  std::sort(latencies.begin(), latencies.end());
+  std::printf("%-10s p50 %8.2f us, p99 %8.2f us, max %8.2f us\n", name,
+              latencies[latencies.size() / 2],
+              latencies[latencies.size() * 99 / 100], latencies.back());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000;
+  std::chrono::microseconds interval(argc > 2 ? std::atoi(argv[2]) : 50);
+  run("blocking", canon::utils::WaitStrategy::blocking(), count, interval);
+  run("yielding", canon::utils::WaitStrategy(0, 1000), count, interval);
+  run("adaptive", canon::utils::WaitStrategy::adaptive(), count, interval);
+  run("spinning", canon::utils::WaitStrategy(1000000, 0), count, interval);
+  return 0;
+}
@@ -0,0 +1,238 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/AsyncSubject.h                               **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_ASYNCSUBJECT_H
+#define CANON_ASYNCSUBJECT_H
+
+#include <utils/CopyOnWriteSignal.h>
+#include <utils/Executor.h>
+#include <utils/QueueStatistics.h>
+#include <utils/SynchronizedQueue.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Subject that decouples its subscribers from the notifying thread. Every
+// subscriber gets a bounded mailbox, a SynchronizedQueue with the given
+// overflow policy, and an Executor delivers the mailbox contents. notify
+// only pushes into the mailboxes, so a slow subscriber fills up and drops
+// from its own mailbox without delaying the producer or anybody else, unless
+// the policy is BlockProducer. Stateful policies like SpillToDisk would be
+// shared by all mailboxes and are not supported.
+//
+// A subscriber is called by at most one worker at a time and sees its
+// notifications in order. It must not throw. The connection tells how many
+// notifications its mailbox dropped and how long they waited in it.
+//
+// The executor must outlive the subject. Destroying the subject or
+// disconnecting discards undelivered notifications and waits for a running
+// delivery of the affected subscribers, unless called from that delivery.
+template <typename Data, typename Overflow = DropOldest> class AsyncSubject {
+  class Mailbox;
+
+public:
+  typedef Data DataType;
+  typedef std::shared_ptr<AsyncSubject<Data, Overflow>> Ptr;
+
+  class Connection {
+  public:
+    Connection() = default;
+
+    bool connected() const { return mailbox && mailbox->opened(); }
+
+    void disconnect() const {
+      link.disconnect();
+      if (mailbox) {
+        mailbox->close();
+      }
+    }
+
+    // only valid for connections returned by connect
+    const QueueStatistics &statistics() const {
+      return mailbox->statistics();
+    }
+
+    size_t dropped() const { return mailbox ? mailbox->dropped() : 0; }
+
+  private:
+    friend class AsyncSubject;
+
+    Connection(CopyOnWriteConnection link, std::shared_ptr<Mailbox> mailbox)
+        : link(std::move(link)), mailbox(std::move(mailbox)) {}
+
+    CopyOnWriteConnection link;
+    std::shared_ptr<Mailbox> mailbox;
+  };
+
+  AsyncSubject(Executor &executor, size_t mailbox_size,
+               Overflow overflow = Overflow())
+      : executor(executor), mailbox_size(mailbox_size), overflow(overflow) {}
+
+  AsyncSubject(const AsyncSubject &) = delete;
+  AsyncSubject &operator=(const AsyncSubject &) = delete;
+
+  virtual ~AsyncSubject() {
+    std::vector<std::weak_ptr<Mailbox>> closing;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      closing.swap(mailboxes);
+    }
+    for (const std::weak_ptr<Mailbox> &weak : closing) {
+      std::shared_ptr<Mailbox> mailbox = weak.lock();
+      if (mailbox) {
+        mailbox->close();
+      }
+    }
+  }
+
+  Connection connect(std::function<void(Data)> subscriber) {
+    std::shared_ptr<Mailbox> mailbox = std::make_shared<Mailbox>(
+        executor, mailbox_size, overflow, std::move(subscriber));
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      // forget mailboxes that were disconnected meanwhile
+      size_t kept = 0;
+      for (std::weak_ptr<Mailbox> &weak : mailboxes) {
+        std::shared_ptr<Mailbox> other = weak.lock();
+        if (other && other->opened()) {
+          mailboxes[kept++] = std::move(weak);
+        }
+      }
+      mailboxes.resize(kept);
+      mailboxes.push_back(mailbox);
+    }
+    return Connection(signal.connect([mailbox](Data data) {
+      mailbox->post(std::move(data));
+    }), mailbox);
+  }
+
+  void disconnect(Connection subscriber) { subscriber.disconnect(); }
+
+  // every mailbox gets a copy, notify moves its own one into the last one
+  void notify(Data data) { signal(std::move(data)); }
+
+  void notify_ref(const Data &data) { signal(data); }
+
+private:
+  class Mailbox : public std::enable_shared_from_this<Mailbox> {
+  public:
+    Mailbox(Executor &executor, size_t size, Overflow overflow,
+            std::function<void(Data)> subscriber)
+        : executor(executor), queue(size, overflow),
+          subscriber(std::move(subscriber)), open(true), scheduled(false),
+          delivering(false) {}
+
+    void post(Data &&data) {
+      if (!open.load()) {
+        return;
+      }
+      queue.try_push(std::move(data));
+      if (!scheduled.exchange(true)) {
+        schedule();
+      }
+    }
+
+    // discards the mailbox, wakes producers blocked on it and waits for a
+    // running delivery to return
+    void close() {
+      open.store(false);
+      queue.close();
+      if (current() == this) {
+        return;
+      }
+      while (delivering.load()) {
+        std::this_thread::yield();
+      }
+    }
+
+    bool opened() const { return open.load(); }
+
+    const QueueStatistics &statistics() const { return queue.statistics(); }
+
+    size_t dropped() const { return queue.dropped(); }
+
+  private:
+    enum { batch_size = 64 };
+
+    typedef SynchronizedQueue<Data, Overflow, QueueStatistics> Queue;
+
+    // the mailbox the calling thread is delivering from
+    static Mailbox *&current() {
+      static thread_local Mailbox *mailbox = nullptr;
+      return mailbox;
+    }
+
+    void schedule() {
+      std::shared_ptr<Mailbox> self = this->shared_from_this();
+      if (!executor.execute([self]() { self->deliver(); })) {
+        scheduled.store(false);
+      }
+    }
+
+    // delivers a batch and gives the worker back, so busy mailboxes take
+    // turns with the other tasks of the executor
+    void deliver() {
+      delivering.store(true);
+      Mailbox *outer = current();
+      current() = this;
+      Data data;
+      size_t count = 0;
+      while (count < batch_size && open.load() && queue.try_pop(data)) {
+        subscriber(std::move(data));
+        ++count;
+      }
+      current() = outer;
+      delivering.store(false);
+      if (count == batch_size && open.load()) {
+        schedule();
+        return;
+      }
+      scheduled.store(false);
+      // a post in between saw scheduled still set
+      if (open.load() && !queue.empty() && !scheduled.exchange(true)) {
+        schedule();
+      }
+    }
+
+    Executor &executor;
+    Queue queue;
+    std::function<void(Data)> subscriber;
+    std::atomic<bool> open;
+    std::atomic<bool> scheduled;
+    std::atomic<bool> delivering;
+  };
+
+  Executor &executor;
+  const size_t mailbox_size;
+  const Overflow overflow;
+  CopyOnWriteSignal<Data> signal;
+  std::mutex mutex;
+  std::vector<std::weak_ptr<Mailbox>> mailboxes;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_ASYNCSUBJECT_H */
@@ -0,0 +1,195 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/ConflatingQueue.h                            **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_CONFLATINGQUEUE_H
+#define CANON_CONFLATINGQUEUE_H
+
+#include <utils/RingBuffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Queue for state updates where only the newest value per key matters.
+// Pushing a value for a key that is already queued replaces the queued value
+// in place and keeps its position, so a consumer sees every key at most once
+// per pass over the queue. When max_size distinct keys are queued the oldest
+// key is dropped. Shutdown behaves like SynchronizedQueue.
+template <typename Key, typename Data, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class ConflatingQueue {
+public:
+  typedef std::mutex Mutex;
+  typedef std::unique_lock<Mutex> Lock;
+  typedef std::condition_variable ConditionVariable;
+
+  ConflatingQueue(size_t maximum_size)
+      : order(std::min<size_t>(maximum_size, preallocation_limit)),
+        max_size(maximum_size), exit(false), consumers(0), drops(0),
+        conflations(0) {
+    values.reserve(order.capacity());
+  }
+
+  ~ConflatingQueue() {
+    {
+      Lock lock(mutex);
+      exit.store(true);
+    }
+    condition.notify_all();
+    // blocked consumers must leave before the mutex goes away
+    while (consumers.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  ConflatingQueue &push(const Key &key, Data const &data) {
+    return emplace(key, data);
+  }
+
+  ConflatingQueue &push(const Key &key, Data &&data) {
+    return emplace(key, std::move(data));
+  }
+
+  template <typename Value>
+  ConflatingQueue &emplace(const Key &key, Value &&value) {
+    Lock lock(mutex);
+    auto queued = values.find(key);
+    if (queued != values.end()) {
+      queued->second = std::forward<Value>(value);
+      conflations.fetch_add(1, std::memory_order_relaxed);
+      return *this;
+    }
+    if (order.size() >= max_size) {
+      drops.fetch_add(1, std::memory_order_relaxed);
+      if (order.empty()) {
+        return *this;
+      }
+      values.erase(order.front());
+      order.pop_front();
+    }
+    values.emplace(key, std::forward<Value>(value));
+    order.push_back(key);
+    lock.unlock();
+    condition.notify_one();
+    return *this;
+  }
+
+  bool empty() const {
+    Lock lock(mutex);
+    return order.empty();
+  }
+
+  // number of distinct keys queued
+  size_t size() const {
+    Lock lock(mutex);
+    return order.size();
+  }
+
+  // number of keys dropped because the queue was full
+  size_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+  // number of pushes that replaced a queued value
+  size_t conflated() const {
+    return conflations.load(std::memory_order_relaxed);
+  }
+
+  bool try_pop(Key &key, Data &data) {
+    Lock lock(mutex);
+    if (order.empty()) {
+      return false;
+    }
+    take(key, data);
+    return true;
+  }
+
+  bool try_pop(Data &data) {
+    Key key;
+    return try_pop(key, data);
+  }
+
+  bool pop(Key &key, Data &data) {
+    consumers.fetch_add(1);
+    bool result = false;
+    {
+      Lock lock(mutex);
+      while (order.empty() && !exit.load()) {
+        condition.wait(lock);
+      }
+      if (!exit.load()) {
+        take(key, data);
+        result = true;
+      }
+    }
+    consumers.fetch_sub(1);
+    return result;
+  }
+
+  bool pop(Data &data) {
+    Key key;
+    return pop(key, data);
+  }
+
+  // appends all queued key/value pairs to out in queue order without
+  // blocking. returns the number of pairs appended.
+  size_t drain(std::vector<std::pair<Key, Data>> &out) {
+    Lock lock(mutex);
+    size_t n = order.size();
+    out.reserve(out.size() + n);
+    while (!order.empty()) {
+      auto queued = values.find(order.front());
+      out.emplace_back(std::move(order.front()), std::move(queued->second));
+      values.erase(queued);
+      order.pop_front();
+    }
+    return n;
+  }
+
+private:
+  enum { preallocation_limit = 65536 };
+
+  void take(Key &key, Data &data) {
+    auto queued = values.find(order.front());
+    data = std::move(queued->second);
+    values.erase(queued);
+    key = std::move(order.front());
+    order.pop_front();
+  }
+
+  std::unordered_map<Key, Data, Hash, KeyEqual> values;
+  RingBuffer<Key> order;
+  mutable Mutex mutex;
+  ConditionVariable condition;
+  size_t max_size;
+  std::atomic<bool> exit;
+  std::atomic<size_t> consumers;
+  std::atomic<size_t> drops;
+  std::atomic<size_t> conflations;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_CONFLATINGQUEUE_H */
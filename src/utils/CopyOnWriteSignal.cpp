@@ -0,0 +1,73 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/CopyOnWriteSignal.cpp                        **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include <utils/CopyOnWriteSignal.h>
+
+using canon::utils::CopyOnWriteConnection;
+using canon::utils::ReadCopyUpdate;
+
+ReadCopyUpdate::ReadCopyUpdate() : current_epoch(0) {
+  readers[0].count.store(0);
+  readers[1].count.store(0);
+}
+
+ReadCopyUpdate::~ReadCopyUpdate() {
+  for (Retired &entry : retired) {
+    entry.deleter();
+  }
+}
+
+void ReadCopyUpdate::retire(std::function<void()> deleter) {
+  current_epoch.fetch_add(1);
+  retired.push_back(Retired{{false, false}, std::move(deleter)});
+  reclaim();
+}
+
+void ReadCopyUpdate::reclaim() {
+  for (Ticket parity = 0; parity < 2; ++parity) {
+    if (readers[parity].count.load() == 0) {
+      for (Retired &entry : retired) {
+        entry.drained[parity] = true;
+      }
+    }
+  }
+  size_t kept = 0;
+  for (Retired &entry : retired) {
+    if (entry.drained[0] && entry.drained[1]) {
+      entry.deleter();
+    } else {
+      // moving an entry onto itself would leave it unspecified
+      if (&retired[kept] != &entry) {
+        retired[kept] = std::move(entry);
+      }
+      ++kept;
+    }
+  }
+  retired.resize(kept);
+}
+
+void CopyOnWriteConnection::disconnect() const {
+  if (!link) {
+    return;
+  }
+  std::shared_ptr<Owner> signal = owner.lock();
+  if (signal) {
+    signal->remove(link.get());
+  } else {
+    link->active.store(false);
+  }
+}
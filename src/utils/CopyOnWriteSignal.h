@@ -0,0 +1,274 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/CopyOnWriteSignal.h                          **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_COPYONWRITESIGNAL_H
+#define CANON_COPYONWRITESIGNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Grace periods for the readers of a copy-on-write structure. Readers
+// bracket their access with enter() and leave(), which never block. Writers
+// publish a replacement and hand the old structure to retire(), which runs
+// its deleter once no reader can still see it. Writers never wait for
+// readers, so a reader may itself write, e.g. disconnect from a signal while
+// it is being emitted.
+//
+// Readers count themselves in one of two counters chosen by the parity of
+// the epoch. A reader that can still see a retired structure entered before
+// it was replaced and is counted until it leaves, in either counter. So the
+// structure is deleted once each counter was seen at zero after the retire.
+// Every retire advances the epoch, which moves new readers to the other
+// counter and lets the old one drain.
+class ReadCopyUpdate {
+public:
+  typedef size_t Ticket;
+
+  ReadCopyUpdate();
+
+  // runs all pending deleters, there must be no readers left
+  ~ReadCopyUpdate();
+
+  ReadCopyUpdate(const ReadCopyUpdate &) = delete;
+  ReadCopyUpdate &operator=(const ReadCopyUpdate &) = delete;
+
+  // the structure must be loaded after enter() returned, with at least
+  // sequentially consistent ordering, so it cannot be read before the reader
+  // is counted
+  Ticket enter() {
+    Ticket ticket = current_epoch.load() & 1;
+    readers[ticket].count.fetch_add(1);
+    return ticket;
+  }
+
+  void leave(Ticket ticket) { readers[ticket].count.fetch_sub(1); }
+
+  // call with the writer lock of the structure held, after the replacement
+  // was published with sequentially consistent ordering
+  void retire(std::function<void()> deleter);
+
+private:
+  enum { cache_line_size = 64 };
+
+  struct Readers {
+    std::atomic<size_t> count;
+    char padding[cache_line_size - sizeof(std::atomic<size_t>)];
+  };
+
+  struct Retired {
+    // whether the counter of each parity was seen at zero since the retire
+    bool drained[2];
+    std::function<void()> deleter;
+  };
+
+  void reclaim();
+
+  Readers readers[2];
+  std::atomic<size_t> current_epoch;
+  std::vector<Retired> retired;
+};
+
+// handle to one subscriber of a CopyOnWriteSignal, compatible with
+// boost::signals2::connection as far as Subject uses it
+class CopyOnWriteConnection {
+public:
+  // the part of a subscriber the connection sees
+  struct Link {
+    Link() : active(true) {}
+    std::atomic<bool> active;
+  };
+
+  // the part of a signal the connection sees
+  class Owner {
+  public:
+    virtual ~Owner() = default;
+    virtual void remove(Link *link) = 0;
+  };
+
+  CopyOnWriteConnection() = default;
+
+  CopyOnWriteConnection(std::shared_ptr<Link> link, std::weak_ptr<Owner> owner)
+      : link(std::move(link)), owner(std::move(owner)) {}
+
+  bool connected() const { return link && link->active.load(); }
+
+  void disconnect() const;
+
+private:
+  std::shared_ptr<Link> link;
+  std::weak_ptr<Owner> owner;
+};
+
+// Signal whose subscribers live in an immutable array. Emitting is an atomic
+// load and direct calls without any lock, connect and disconnect copy the
+// array under a writer lock and retire the old one through ReadCopyUpdate.
+// A subscriber disconnected during an emission is not called anymore.
+//
+// Subscribers connected with connect_ref see the emitted value itself, the
+// ones connected with connect get their own copy, except for the last one
+// of an rvalue emission which gets the value moved in.
+template <typename Data> class CopyOnWriteSignal {
+public:
+  typedef CopyOnWriteConnection Connection;
+
+  CopyOnWriteSignal() : core(std::make_shared<Core>()) {}
+
+  CopyOnWriteSignal(const CopyOnWriteSignal &) = delete;
+  CopyOnWriteSignal &operator=(const CopyOnWriteSignal &) = delete;
+
+  Connection connect(std::function<void(Data)> function) {
+    return add(std::make_shared<Slot>(std::move(function)));
+  }
+
+  Connection connect_ref(std::function<void(const Data &)> function) {
+    return add(std::make_shared<Slot>(std::move(function)));
+  }
+
+  void operator()(const Data &data) const {
+    Reader reader(core->rcu);
+    const Slots &slots = *core->slots.load();
+    for (const std::shared_ptr<Slot> &slot : slots) {
+      slot->deliver(data);
+    }
+  }
+
+  void operator()(Data &&data) const {
+    Reader reader(core->rcu);
+    const Slots &slots = *core->slots.load();
+    if (slots.empty()) {
+      return;
+    }
+    for (size_t i = 0; i + 1 < slots.size(); ++i) {
+      slots[i]->deliver(static_cast<const Data &>(data));
+    }
+    slots.back()->deliver(std::move(data));
+  }
+
+private:
+  struct Slot : public Connection::Link {
+    explicit Slot(std::function<void(Data)> function)
+        : value(std::move(function)) {}
+
+    explicit Slot(std::function<void(const Data &)> function)
+        : reference(std::move(function)) {}
+
+    void deliver(const Data &data) const {
+      if (!active.load(std::memory_order_relaxed)) {
+        return;
+      }
+      if (reference) {
+        reference(data);
+      } else {
+        value(data);
+      }
+    }
+
+    void deliver(Data &&data) const {
+      if (!active.load(std::memory_order_relaxed)) {
+        return;
+      }
+      if (reference) {
+        reference(data);
+      } else {
+        value(std::move(data));
+      }
+    }
+
+    // exactly one of them is set
+    std::function<void(const Data &)> reference;
+    std::function<void(Data)> value;
+  };
+
+  typedef std::vector<std::shared_ptr<Slot>> Slots;
+
+  class Core : public Connection::Owner {
+  public:
+    Core() : slots(new Slots()) {}
+
+    ~Core() {
+      const Slots *current = slots.load();
+      for (const std::shared_ptr<Slot> &slot : *current) {
+        slot->active.store(false);
+      }
+      delete current;
+    }
+
+    void add(const std::shared_ptr<Slot> &slot) {
+      std::lock_guard<std::mutex> lock(writer);
+      const Slots *current = slots.load();
+      Slots *next = new Slots(*current);
+      next->push_back(slot);
+      publish(current, next);
+    }
+
+    void remove(Connection::Link *link) override {
+      std::lock_guard<std::mutex> lock(writer);
+      link->active.store(false);
+      const Slots *current = slots.load();
+      Slots *next = new Slots();
+      next->reserve(current->size());
+      for (const std::shared_ptr<Slot> &slot : *current) {
+        if (slot.get() != link) {
+          next->push_back(slot);
+        }
+      }
+      publish(current, next);
+    }
+
+    ReadCopyUpdate rcu;
+    std::atomic<const Slots *> slots;
+
+  private:
+    void publish(const Slots *current, Slots *next) {
+      slots.store(next);
+      rcu.retire([current]() { delete current; });
+    }
+
+    std::mutex writer;
+  };
+
+  Connection add(const std::shared_ptr<Slot> &slot) {
+    core->add(slot);
+    return Connection(slot, core);
+  }
+
+  // leaves the read side even when a subscriber throws
+  class Reader {
+  public:
+    explicit Reader(ReadCopyUpdate &rcu) : rcu(rcu), ticket(rcu.enter()) {}
+    ~Reader() { rcu.leave(ticket); }
+
+  private:
+    ReadCopyUpdate &rcu;
+    ReadCopyUpdate::Ticket ticket;
+  };
+
+  std::shared_ptr<Core> core;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_COPYONWRITESIGNAL_H */
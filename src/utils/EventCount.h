@@ -0,0 +1,90 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/EventCount.h                                 **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_EVENTCOUNT_H
+#define CANON_EVENTCOUNT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace canon {
+namespace utils {
+
+// Lets lock-free containers park idle threads without taking a lock on the
+// fast path. A waiter calls prepare_wait(), re-checks its condition and then
+// either cancel_wait() or wait(key). Notifiers only touch the mutex when
+// somebody is actually waiting.
+class EventCount {
+public:
+  typedef std::mutex Mutex;
+  typedef std::unique_lock<Mutex> Lock;
+  typedef std::condition_variable ConditionVariable;
+  typedef uint64_t Key;
+
+  EventCount() : epoch(0), waiters(0) {}
+
+  Key prepare_wait() {
+    waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch.load(std::memory_order_acquire);
+  }
+
+  void cancel_wait() { waiters.fetch_sub(1); }
+
+  void wait(Key key) {
+    Lock lock(mutex);
+    while (epoch.load(std::memory_order_relaxed) == key) {
+      condition.wait(lock);
+    }
+    waiters.fetch_sub(1);
+  }
+
+  void notify_one() {
+    if (advance()) {
+      condition.notify_one();
+    }
+  }
+
+  void notify_all() {
+    if (advance()) {
+      condition.notify_all();
+    }
+  }
+
+private:
+  bool advance() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed) == 0) {
+      return false;
+    }
+    Lock lock(mutex);
+    epoch.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  std::atomic<Key> epoch;
+  std::atomic<size_t> waiters;
+  Mutex mutex;
+  ConditionVariable condition;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_EVENTCOUNT_H */
@@ -0,0 +1,229 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/Executor.cpp                                 **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include <utils/Executor.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using canon::utils::Executor;
+
+namespace {
+
+// the executor and worker index of the calling thread, if it is a worker
+thread_local const Executor *current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+void pin_to_core(size_t index) {
+#ifdef __linux__
+  unsigned cores = std::thread::hardware_concurrency();
+  if (cores == 0) {
+    return;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(index % cores, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)index;
+#endif
+}
+
+} // namespace
+
+Executor::Executor(size_t threads, bool pin_to_cores)
+    : next(0), pending(0), closing(false), exit(false) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back(new Worker());
+  }
+  // workers steal from each other, so all deques exist before any thread
+  for (size_t i = 0; i < threads; ++i) {
+    workers[i]->thread = std::thread(&Executor::run, this, i, pin_to_cores);
+  }
+}
+
+Executor::~Executor() {
+  exit.store(true);
+  stop();
+}
+
+bool Executor::execute(Task task) {
+  if (!reserve(1)) {
+    return false;
+  }
+  size_t index = current_executor == this
+                     ? current_worker
+                     : next.fetch_add(1, std::memory_order_relaxed);
+  Worker &worker = *workers[index % workers.size()];
+  {
+    Lock lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  events.notify_one();
+  return true;
+}
+
+bool Executor::execute_bulk(std::vector<Task> &tasks) {
+  if (tasks.empty()) {
+    return accepts();
+  } else if (!reserve(tasks.size())) {
+    return false;
+  }
+  size_t count = workers.size();
+  size_t chunk = (tasks.size() + count - 1) / count;
+  size_t first = next.fetch_add(1, std::memory_order_relaxed);
+  auto task = tasks.begin();
+  for (size_t i = 0; task != tasks.end(); ++i) {
+    Worker &worker = *workers[(first + i) % count];
+    auto end = tasks.end() - task > static_cast<ptrdiff_t>(chunk)
+                   ? task + chunk
+                   : tasks.end();
+    Lock lock(worker.mutex);
+    for (; task != end; ++task) {
+      worker.tasks.push_back(std::move(*task));
+    }
+  }
+  events.notify_all();
+  return true;
+}
+
+bool Executor::accepts() const {
+  // tasks of running tasks belong to the work close() lets finish
+  return !closing.load() || current_executor == this;
+}
+
+bool Executor::reserve(size_t count) {
+  // counted before closing is checked: workers only leave once they saw
+  // closing and no pending tasks, so either they wait for these tasks or
+  // this sees closing
+  pending.fetch_add(count);
+  if (!accepts()) {
+    pending.fetch_sub(count);
+    return false;
+  }
+  return true;
+}
+
+void Executor::close() {
+  closing.store(true);
+  events.notify_all();
+}
+
+void Executor::join() {
+  close();
+  stop();
+}
+
+void Executor::stop() {
+  // join and the destructor may race for the threads
+  std::lock_guard<std::mutex> lock(join_mutex);
+  events.notify_all();
+  for (auto &worker : workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+  // only left when exit discarded them
+  for (auto &worker : workers) {
+    worker->tasks.clear();
+  }
+  pending.store(0);
+}
+
+void Executor::run(size_t index, bool pin) {
+  current_executor = this;
+  current_worker = index;
+  if (pin) {
+    pin_to_core(index);
+  }
+  Task task;
+  while (!exit.load()) {
+    if (find_task(index, task)) {
+      task();
+      task = nullptr;
+      continue;
+    }
+    if (closing.load() && pending.load() == 0) {
+      break;
+    }
+    EventCount::Key key = events.prepare_wait();
+    if (pending.load() != 0 || closing.load() || exit.load()) {
+      events.cancel_wait();
+      // another worker may hold the last tasks for a moment
+      std::this_thread::yield();
+      continue;
+    }
+    events.wait(key);
+  }
+  current_executor = nullptr;
+}
+
+bool Executor::find_task(size_t index, Task &task) {
+  Worker &own = *workers[index];
+  {
+    Lock lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      pending.fetch_sub(1);
+      return true;
+    }
+  }
+  if (pending.load() == 0) {
+    return false;
+  }
+  for (size_t i = 1; i < workers.size(); ++i) {
+    if (steal(index, (index + i) % workers.size(), task)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Executor::steal(size_t thief, size_t victim, Task &task) {
+  std::vector<Task> stolen;
+  {
+    Lock lock(workers[victim]->mutex);
+    std::deque<Task> &tasks = workers[victim]->tasks;
+    if (tasks.empty()) {
+      return false;
+    }
+    // take the newer half, the victim keeps working on the older one
+    size_t count = (tasks.size() + 1) / 2;
+    stolen.reserve(count);
+    for (auto it = tasks.end() - count; it != tasks.end(); ++it) {
+      stolen.push_back(std::move(*it));
+    }
+    tasks.erase(tasks.end() - count, tasks.end());
+    pending.fetch_sub(1);
+  }
+  task = std::move(stolen.front());
+  if (stolen.size() > 1) {
+    Lock lock(workers[thief]->mutex);
+    for (auto it = stolen.begin() + 1; it != stolen.end(); ++it) {
+      workers[thief]->tasks.push_back(std::move(*it));
+    }
+  }
+  return true;
+}
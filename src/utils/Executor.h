@@ -0,0 +1,145 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/Executor.h                                   **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_EXECUTOR_H
+#define CANON_EXECUTOR_H
+
+#include <utils/EventCount.h>
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Thread pool with one task deque per worker. Tasks submitted from outside
+// are spread round-robin over the workers, tasks submitted from a worker go
+// to its own deque. A worker without tasks steals half of the tasks of
+// another one before it parks, so there is no global lock every task has to
+// pass.
+//
+// Shutdown works like SynchronizedQueue: close() rejects new tasks and lets
+// the workers finish the queued ones and whatever those spawn, join()
+// additionally waits for that.
+// The destructor discards tasks that did not start yet, their futures report
+// std::future_errc::broken_promise, and waits for running tasks.
+class Executor {
+public:
+  typedef std::function<void()> Task;
+
+  // threads == 0 starts one worker per hardware thread. pin_to_cores binds
+  // worker i to core i modulo the number of cores where supported.
+  explicit Executor(size_t threads = 0, bool pin_to_cores = false);
+  ~Executor();
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  // runs the task on some worker. returns false when the executor is closed,
+  // unless called from one of its running tasks.
+  // an exception escaping the task terminates the program, use submit to
+  // get it through a future instead.
+  bool execute(Task task);
+
+  // distributes the tasks over all workers, locking every worker once
+  template <typename InputIt> bool execute_range(InputIt first, InputIt last) {
+    std::vector<Task> tasks(first, last);
+    return execute_bulk(tasks);
+  }
+
+  template <typename Function>
+  std::future<typename std::result_of<Function()>::type>
+  submit(Function &&function) {
+    typedef typename std::result_of<Function()>::type Result;
+    // std::function needs a copyable target
+    auto task = std::make_shared<std::packaged_task<Result()>>(
+        std::forward<Function>(function));
+    std::future<Result> result = task->get_future();
+    execute([task]() { (*task)(); });
+    return result;
+  }
+
+  // bulk version of submit, the futures are in the order of the functions
+  template <typename InputIt>
+  std::vector<std::future<typename std::result_of<
+      typename std::iterator_traits<InputIt>::value_type()>::type>>
+  submit_range(InputIt first, InputIt last) {
+    typedef typename std::result_of<
+        typename std::iterator_traits<InputIt>::value_type()>::type Result;
+    std::vector<std::future<Result>> results;
+    std::vector<Task> tasks;
+    for (; first != last; ++first) {
+      auto task = std::make_shared<std::packaged_task<Result()>>(*first);
+      results.push_back(task->get_future());
+      tasks.push_back([task]() { (*task)(); });
+    }
+    execute_bulk(tasks);
+    return results;
+  }
+
+  // rejects all further tasks, the workers still run the queued ones
+  void close();
+
+  // closes the executor and waits until all queued tasks ran
+  void join();
+
+  bool closed() const { return closing.load(); }
+
+  size_t size() const { return workers.size(); }
+
+private:
+  typedef std::mutex Mutex;
+  typedef std::lock_guard<Mutex> Lock;
+
+  struct Worker {
+    Mutex mutex;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  bool execute_bulk(std::vector<Task> &tasks);
+  bool accepts() const;
+  bool reserve(size_t count);
+  void run(size_t index, bool pin);
+  bool find_task(size_t index, Task &task);
+  bool steal(size_t thief, size_t victim, Task &task);
+  void stop();
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::atomic<size_t> next;
+  // tasks in all deques, lets idle workers park without scanning
+  std::atomic<size_t> pending;
+  std::atomic<bool> closing;
+  std::atomic<bool> exit;
+  std::mutex join_mutex;
+  EventCount events;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_EXECUTOR_H */
@@ -0,0 +1,81 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/MpmcQueue.h                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_MPMCQUEUE_H
+#define CANON_MPMCQUEUE_H
+
+#include <utils/SlotQueue.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Bounded lock-free queue for any number of producers and consumers with the
+// interface and drop-oldest semantics of SynchronizedQueue.
+//
+// Producers and consumers claim positions with a CAS on tail and head
+// respectively and synchronize with each other through the sequence numbers
+// of SlotQueue, so there is no global lock on the fast path.
+template <typename Data> class MpmcQueue : public SlotQueue<Data> {
+public:
+  MpmcQueue(size_t maximum_size) : SlotQueue<Data>(maximum_size) {}
+
+  MpmcQueue &push(Data const &data) { return emplace(data); }
+
+  MpmcQueue &push(Data &&data) { return emplace(std::move(data)); }
+
+  template <typename... Args> MpmcQueue &emplace(Args &&... args) {
+    if (this->max_size == 0)
+      return *this;
+    size_t pos = this->tail.load(std::memory_order_relaxed);
+    for (;;) {
+      typename SlotQueue<Data>::Slot &slot = this->slot_at(pos);
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq - pos);
+      if (diff == 0) {
+        if (this->tail.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+          this->fill(slot, pos, std::forward<Args>(args)...);
+          this->events.notify_one();
+          return *this;
+        }
+      } else if (diff < 0) {
+        // when full overwrite the oldest element, otherwise another thread
+        // is still busy with the slot
+        // pos may be stale and already behind head
+        intptr_t queued = static_cast<intptr_t>(
+            pos - this->head.load(std::memory_order_acquire));
+        if (queued < static_cast<intptr_t>(this->max_size) ||
+            !this->discard()) {
+          std::this_thread::yield();
+        }
+        pos = this->tail.load(std::memory_order_relaxed);
+      } else {
+        pos = this->tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_MPMCQUEUE_H */
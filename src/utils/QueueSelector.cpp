@@ -0,0 +1,158 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/QueueSelector.cpp                            **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include <utils/QueueSelector.h>
+
+#ifdef __linux__
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+using canon::utils::QueueSelector;
+
+QueueSelector::QueueSelector() : next(0), closed(false), event_fd(-1) {}
+
+QueueSelector::~QueueSelector() {
+  // no listener may call into the selector after this
+  for (auto &unsubscribe : unsubscribers) {
+    unsubscribe();
+  }
+#ifdef __linux__
+  if (event_fd >= 0) {
+    ::close(event_fd);
+  }
+#endif
+}
+
+size_t QueueSelector::add(ReadyCheck ready, Subscribe subscribe) {
+  size_t index;
+  {
+    Lock lock(mutex);
+    index = ready_checks.size();
+    ready_checks.push_back(ready);
+    // the queue may already hold data
+    signaled.push_back(true);
+  }
+  // outside the lock, the queue calls signal under its own lock
+  std::function<void()> unsubscribe =
+      subscribe([this, index]() { signal(index); });
+  {
+    Lock lock(mutex);
+    unsubscribers.push_back(std::move(unsubscribe));
+  }
+  condition.notify_all();
+  return index;
+}
+
+void QueueSelector::signal(size_t index) {
+  Lock lock(mutex);
+  signaled[index] = true;
+  wake_handle();
+  lock.unlock();
+  condition.notify_one();
+}
+
+bool QueueSelector::find_ready(size_t &index) {
+  size_t count = ready_checks.size();
+  for (size_t k = 0; k < count; ++k) {
+    size_t i = (next + k) % count;
+    if (!signaled[i]) {
+      continue;
+    }
+    if (ready_checks[i]()) {
+      // stays signaled, the queue may hold more than one element
+      index = i;
+      next = i + 1;
+      return true;
+    }
+    signaled[i] = false;
+  }
+  return false;
+}
+
+bool QueueSelector::select(size_t &index) {
+  Lock lock(mutex);
+  while (!closed) {
+    if (find_ready(index)) {
+      return true;
+    }
+    condition.wait(lock);
+  }
+  return false;
+}
+
+bool QueueSelector::select_until(
+    size_t &index, const std::chrono::steady_clock::time_point &deadline) {
+  Lock lock(mutex);
+  while (!closed) {
+    if (find_ready(index)) {
+      return true;
+    }
+    if (condition.wait_until(lock, deadline) == std::cv_status::timeout) {
+      return !closed && find_ready(index);
+    }
+  }
+  return false;
+}
+
+bool QueueSelector::try_select(size_t &index) {
+  Lock lock(mutex);
+  if (closed) {
+    return false;
+  } else if (find_ready(index)) {
+    return true;
+  }
+#ifdef __linux__
+  if (event_fd >= 0) {
+    uint64_t count;
+    ssize_t read = ::read(event_fd, &count, sizeof(count));
+    (void)read;
+  }
+#endif
+  return false;
+}
+
+int QueueSelector::native_handle() {
+  Lock lock(mutex);
+#ifdef __linux__
+  if (event_fd < 0) {
+    event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    // report everything signaled so far
+    wake_handle();
+  }
+#endif
+  return event_fd;
+}
+
+void QueueSelector::wake_handle() {
+#ifdef __linux__
+  if (event_fd >= 0) {
+    uint64_t one = 1;
+    ssize_t written = ::write(event_fd, &one, sizeof(one));
+    (void)written;
+  }
+#endif
+}
+
+void QueueSelector::close() {
+  Lock lock(mutex);
+  closed = true;
+  wake_handle();
+  lock.unlock();
+  condition.notify_all();
+}
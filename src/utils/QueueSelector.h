@@ -0,0 +1,114 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/QueueSelector.h                              **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_QUEUESELECTOR_H
+#define CANON_QUEUESELECTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Waits on several SynchronizedQueues at once, like select(2) on sockets.
+//
+//   QueueSelector selector;
+//   size_t images = selector.add(image_queue);
+//   size_t poses = selector.add(pose_queue);
+//   size_t ready;
+//   while (selector.select(ready)) {
+//     if (ready == images && image_queue.try_pop(image)) ...
+//   }
+//
+// Queues signal the selector on push, so select never polls. Readiness is
+// level-triggered: a queue is reported for as long as it holds data, queues
+// are served round-robin. native_handle() returns an eventfd that becomes
+// readable whenever a queue may have data, so the selector can also be
+// driven from an external epoll loop with try_select. A queue may be added
+// to several selectors, all of them get signaled. Registered queues must
+// outlive the selector.
+class QueueSelector {
+public:
+  typedef std::mutex Mutex;
+  typedef std::unique_lock<Mutex> Lock;
+  typedef std::condition_variable ConditionVariable;
+
+  QueueSelector();
+  ~QueueSelector();
+
+  QueueSelector(const QueueSelector &) = delete;
+  QueueSelector &operator=(const QueueSelector &) = delete;
+
+  // registers the queue and returns the index select reports for it
+  template <typename Queue> size_t add(Queue &queue) {
+    return add([&queue]() { return !queue.empty(); },
+               [&queue](std::function<void()> listener) {
+                 size_t key = queue.add_listener(std::move(listener));
+                 return [&queue, key]() { queue.remove_listener(key); };
+               });
+  }
+
+  // blocks until a queue holds data and stores its index. returns false when
+  // the selector gets closed.
+  bool select(size_t &index);
+
+  template <typename Rep, typename Period>
+  bool select_for(size_t &index,
+                  const std::chrono::duration<Rep, Period> &timeout) {
+    return select_until(index, std::chrono::steady_clock::now() + timeout);
+  }
+
+  bool select_until(size_t &index,
+                    const std::chrono::steady_clock::time_point &deadline);
+
+  // does not block. resets the eventfd when no queue holds data.
+  bool try_select(size_t &index);
+
+  // an eventfd for epoll, created on first use. -1 when not supported.
+  int native_handle();
+
+  // wakes all selecting threads with false
+  void close();
+
+private:
+  typedef std::function<bool()> ReadyCheck;
+  // registers a listener with the queue and returns a function removing it
+  typedef std::function<std::function<void()>(std::function<void()>)>
+      Subscribe;
+
+  size_t add(ReadyCheck ready, Subscribe subscribe);
+  void signal(size_t index);
+  bool find_ready(size_t &index);
+  void wake_handle();
+
+  Mutex mutex;
+  ConditionVariable condition;
+  std::vector<ReadyCheck> ready_checks;
+  std::vector<std::function<void()>> unsubscribers;
+  std::vector<bool> signaled;
+  size_t next;
+  bool closed;
+  int event_fd;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_QUEUESELECTOR_H */
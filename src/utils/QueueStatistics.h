@@ -0,0 +1,170 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/QueueStatistics.h                            **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_QUEUESTATISTICS_H
+#define CANON_QUEUESTATISTICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace canon {
+namespace utils {
+
+// Statistics policies for SynchronizedQueue. The queue calls the hooks while
+// holding its lock and stores a Stamp next to every element. Besides the
+// depth the hooks get the queued load: the payload bytes when the queue is
+// bounded by a ByteBudget, the element count otherwise.
+
+// the default: empty hooks and an empty Stamp, compiled away completely
+struct NoStatistics {
+  struct Stamp {};
+
+  void pushed(Stamp &, size_t, size_t) {}
+  void popped(const Stamp &, size_t, size_t) {}
+  void dropped(size_t, size_t) {}
+};
+
+// Counts pushes, pops and drops, tracks current and peak depth and load and
+// records how long elements stayed in the queue in a histogram with power of
+// two buckets: bucket i counts dwell times in [2^(i-1), 2^i) nanoseconds.
+// Every value can be read lock-free from any thread at any time.
+class QueueStatistics {
+public:
+  typedef std::chrono::steady_clock Clock;
+  enum { histogram_buckets = 40 };
+  typedef std::array<uint64_t, histogram_buckets> Histogram;
+
+  struct Stamp {
+    Clock::time_point enqueued;
+  };
+
+  struct Snapshot {
+    uint64_t pushes;
+    uint64_t pops;
+    uint64_t drops;
+    uint64_t depth;
+    uint64_t peak_depth;
+    uint64_t bytes;
+    uint64_t peak_bytes;
+    Histogram dwell_histogram;
+
+    // upper bound in nanoseconds of the dwell time of the given fraction of
+    // all popped elements, e.g. 0.99 for the 99th percentile
+    uint64_t dwell_percentile(double fraction) const {
+      uint64_t total = 0;
+      for (uint64_t count : dwell_histogram) {
+        total += count;
+      }
+      uint64_t seen = 0;
+      for (size_t i = 0; i < histogram_buckets; ++i) {
+        seen += dwell_histogram[i];
+        if (total != 0 && seen >= fraction * total) {
+          return uint64_t(1) << i;
+        }
+      }
+      return 0;
+    }
+  };
+
+  QueueStatistics()
+      : pushes(0), pops(0), drops(0), depth(0), peak_depth(0), bytes(0),
+        peak_bytes(0) {
+    for (auto &bucket : dwell_histogram) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  QueueStatistics(const QueueStatistics &) = delete;
+  QueueStatistics &operator=(const QueueStatistics &) = delete;
+
+  Snapshot snapshot() const {
+    Snapshot result;
+    result.pushes = pushes.load(std::memory_order_relaxed);
+    result.pops = pops.load(std::memory_order_relaxed);
+    result.drops = drops.load(std::memory_order_relaxed);
+    result.depth = depth.load(std::memory_order_relaxed);
+    result.peak_depth = peak_depth.load(std::memory_order_relaxed);
+    result.bytes = bytes.load(std::memory_order_relaxed);
+    result.peak_bytes = peak_bytes.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < histogram_buckets; ++i) {
+      result.dwell_histogram[i] =
+          dwell_histogram[i].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+  // hooks called by the queue, always under its lock. so there is only ever
+  // one writer and the counters do not need read-modify-write operations.
+
+  void pushed(Stamp &stamp, size_t new_depth, size_t new_bytes) {
+    stamp.enqueued = Clock::now();
+    increment(pushes, 1);
+    update(depth, peak_depth, new_depth);
+    update(bytes, peak_bytes, new_bytes);
+  }
+
+  void popped(const Stamp &stamp, size_t new_depth, size_t new_bytes) {
+    increment(pops, 1);
+    update(depth, peak_depth, new_depth);
+    update(bytes, peak_bytes, new_bytes);
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now() - stamp.enqueued)
+                      .count();
+    increment(dwell_histogram[bucket(ns)], 1);
+  }
+
+  void dropped(size_t new_depth, size_t new_bytes) {
+    increment(drops, 1);
+    update(depth, peak_depth, new_depth);
+    update(bytes, peak_bytes, new_bytes);
+  }
+
+private:
+  static void increment(std::atomic<uint64_t> &counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  static size_t bucket(uint64_t ns) {
+    size_t i = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    return i < histogram_buckets ? i : histogram_buckets - 1;
+  }
+
+  static void update(std::atomic<uint64_t> &current,
+                     std::atomic<uint64_t> &peak, uint64_t value) {
+    current.store(value, std::memory_order_relaxed);
+    if (value > peak.load(std::memory_order_relaxed)) {
+      peak.store(value, std::memory_order_relaxed);
+    }
+  }
+
+  std::atomic<uint64_t> pushes;
+  std::atomic<uint64_t> pops;
+  std::atomic<uint64_t> drops;
+  std::atomic<uint64_t> depth;
+  std::atomic<uint64_t> peak_depth;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> peak_bytes;
+  std::array<std::atomic<uint64_t>, histogram_buckets> dwell_histogram;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_QUEUESTATISTICS_H */
@@ -0,0 +1,128 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/RingBuffer.h                                 **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_RINGBUFFER_H
+#define CANON_RINGBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Contiguous FIFO storage with a fixed capacity that is allocated up front.
+// Elements are constructed in place and destroyed on pop_front, so a buffer
+// that never exceeds its capacity does not allocate after construction.
+// Pushing into a full buffer doubles the capacity.
+template <typename T, typename Allocator = std::allocator<T>>
+class RingBuffer {
+private:
+  typedef std::allocator_traits<Allocator> Traits;
+
+public:
+  typedef T value_type;
+  typedef Allocator allocator_type;
+
+  explicit RingBuffer(size_t capacity = 0, const Allocator &alloc = Allocator())
+      : allocator(alloc), elements(nullptr), storage_size(0), first(0),
+        count(0) {
+    reserve(capacity);
+  }
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  ~RingBuffer() {
+    clear();
+    if (elements != nullptr) {
+      Traits::deallocate(allocator, elements, storage_size);
+    }
+  }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return storage_size; }
+  bool empty() const { return count == 0; }
+
+  T &front() { return elements[first]; }
+  const T &front() const { return elements[first]; }
+  T &back() { return elements[index(count - 1)]; }
+  const T &back() const { return elements[index(count - 1)]; }
+
+  T &operator[](size_t i) { return elements[index(i)]; }
+  const T &operator[](size_t i) const { return elements[index(i)]; }
+
+  template <typename... Args> void emplace_back(Args &&... args) {
+    if (count == storage_size) {
+      reserve(storage_size == 0 ? 1 : 2 * storage_size);
+    }
+    Traits::construct(allocator, elements + index(count),
+                      std::forward<Args>(args)...);
+    ++count;
+  }
+
+  void push_back(const T &value) { emplace_back(value); }
+  void push_back(T &&value) { emplace_back(std::move(value)); }
+
+  void pop_front() {
+    Traits::destroy(allocator, elements + first);
+    first = index(1);
+    --count;
+  }
+
+  void clear() {
+    while (!empty()) {
+      pop_front();
+    }
+  }
+
+  // grows the storage to hold at least capacity elements
+  void reserve(size_t capacity) {
+    if (capacity <= storage_size) {
+      return;
+    }
+    T *grown = Traits::allocate(allocator, capacity);
+    for (size_t i = 0; i < count; ++i) {
+      T &element = elements[index(i)];
+      Traits::construct(allocator, grown + i, std::move(element));
+      Traits::destroy(allocator, &element);
+    }
+    if (elements != nullptr) {
+      Traits::deallocate(allocator, elements, storage_size);
+    }
+    elements = grown;
+    storage_size = capacity;
+    first = 0;
+  }
+
+private:
+  size_t index(size_t i) const {
+    size_t j = first + i;
+    return j >= storage_size ? j - storage_size : j;
+  }
+
+  Allocator allocator;
+  T *elements;
+  size_t storage_size;
+  size_t first;
+  size_t count;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_RINGBUFFER_H */
@@ -0,0 +1,379 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SharedMemoryQueue.cpp                        **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include <utils/SharedMemoryQueue.h>
+#include <utils/Exception.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using canon::utils::Exception;
+using canon::utils::SharedMemoryQueue;
+
+namespace {
+
+enum {
+  cache_line_size = 64,
+  spin_count = 64,
+  // attach attempts while another process still creates the segment
+  open_attempts = 1000
+};
+
+const uint64_t segment_magic = 0x63616e6f6e73686dULL; // "canonshm"
+
+size_t round_up(size_t size) {
+  return (size + cache_line_size - 1) / cache_line_size * cache_line_size;
+}
+
+Exception system_error(const std::string &what, const std::string &name) {
+  return Exception(what + " '" + name + "': " + std::strerror(errno));
+}
+
+#ifdef __linux__
+// not FUTEX_PRIVATE_FLAG, the waiters live in other processes
+void futex_wait(std::atomic<uint32_t> *word, uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected,
+          nullptr, nullptr, 0);
+}
+
+void futex_wake_all(std::atomic<uint32_t> *word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT32_MAX,
+          nullptr, nullptr, 0);
+}
+#endif
+
+} // namespace
+
+// the start of the segment, followed by slot_count slots
+struct SharedMemoryQueue::Header {
+  // written last by the creating process
+  std::atomic<uint64_t> magic;
+  uint64_t slot_size;
+  uint64_t slot_count;
+  char head_padding[cache_line_size];
+  std::atomic<uint64_t> head;
+  char tail_padding[cache_line_size - sizeof(std::atomic<uint64_t>)];
+  std::atomic<uint64_t> tail;
+  char state_padding[cache_line_size - sizeof(std::atomic<uint64_t>)];
+  // futex word, bumped whenever sleeping consumers have to re-check
+  std::atomic<uint32_t> epoch;
+  std::atomic<uint32_t> waiters;
+  std::atomic<uint32_t> closed;
+  std::atomic<uint64_t> drops;
+};
+
+SharedMemoryQueue::SharedMemoryQueue(const std::string &name,
+                                     size_t slot_size, size_t slot_count)
+    : fd(-1), segment(nullptr), segment_size(0), header(nullptr),
+      slot_bytes(0), slot_count(0), slot_stride(0), exit(false),
+      consumers(0) {
+  open(name, slot_size, slot_count, true);
+}
+
+SharedMemoryQueue::SharedMemoryQueue(const std::string &name)
+    : fd(-1), segment(nullptr), segment_size(0), header(nullptr),
+      slot_bytes(0), slot_count(0), slot_stride(0), exit(false),
+      consumers(0) {
+  open(name, 0, 0, false);
+}
+
+SharedMemoryQueue::~SharedMemoryQueue() {
+  exit.store(true);
+  notify_all();
+  // blocked consumers must leave before the mapping goes away
+  while (consumers.load() != 0) {
+    std::this_thread::yield();
+  }
+#ifdef __linux__
+  munmap(segment, segment_size);
+  ::close(fd);
+#endif
+}
+
+void SharedMemoryQueue::remove(const std::string &name) {
+#ifdef __linux__
+  if (shm_unlink(name.c_str()) != 0 && errno != ENOENT) {
+    throw system_error("Could not remove shared memory segment", name);
+  }
+#else
+  (void)name;
+#endif
+}
+
+void SharedMemoryQueue::open(const std::string &name, size_t slot_size,
+                             size_t count, bool create) {
+#ifdef __linux__
+  if (create && count == 0) {
+    throw Exception("Shared memory queue '" + name + "' needs slots");
+  }
+  bool creator = false;
+  if (create) {
+    fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    creator = fd >= 0;
+    if (!creator && errno != EEXIST) {
+      throw system_error("Could not create shared memory segment", name);
+    }
+  }
+  if (!creator) {
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+      throw system_error("Could not open shared memory segment", name);
+    }
+  }
+  size_t stride = round_up(sizeof(Slot) + slot_size);
+  size_t size = round_up(sizeof(Header)) + stride * count;
+  if (creator) {
+    if (ftruncate(fd, size) != 0) {
+      ::close(fd);
+      shm_unlink(name.c_str());
+      throw system_error("Could not size shared memory segment", name);
+    }
+  } else {
+    // the creator may not have sized the segment yet
+    struct stat status;
+    for (size_t i = 0;; ++i) {
+      if (fstat(fd, &status) != 0 || i == open_attempts) {
+        ::close(fd);
+        throw Exception("Shared memory segment '" + name +
+                        "' was not initialized");
+      } else if (status.st_size != 0) {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    size = status.st_size;
+  }
+  void *mapping =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    ::close(fd);
+    throw system_error("Could not map shared memory segment", name);
+  }
+  segment = static_cast<char *>(mapping);
+  segment_size = size;
+  if (creator) {
+    header = new (segment) Header();
+    header->slot_size = slot_size;
+    header->slot_count = count;
+    header->head.store(0, std::memory_order_relaxed);
+    header->tail.store(0, std::memory_order_relaxed);
+    header->epoch.store(0, std::memory_order_relaxed);
+    header->waiters.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->drops.store(0, std::memory_order_relaxed);
+  } else {
+    header = reinterpret_cast<Header *>(segment);
+    for (size_t i = 0;
+         header->magic.load(std::memory_order_acquire) != segment_magic; ++i) {
+      if (i == open_attempts) {
+        munmap(segment, segment_size);
+        ::close(fd);
+        throw Exception("Shared memory segment '" + name +
+                        "' was not initialized");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  slot_bytes = header->slot_size;
+  slot_count = header->slot_count;
+  slot_stride = round_up(sizeof(Slot) + slot_bytes);
+  if (create && (slot_bytes != slot_size || slot_count != count)) {
+    munmap(segment, segment_size);
+    ::close(fd);
+    throw Exception("Shared memory segment '" + name +
+                    "' exists with another geometry");
+  }
+  if (creator) {
+    for (size_t i = 0; i < slot_count; ++i) {
+      new (slot_at(i)) Slot();
+      slot_at(i)->sequence.store(i, std::memory_order_relaxed);
+    }
+    header->magic.store(segment_magic, std::memory_order_release);
+  }
+#else
+  (void)slot_size;
+  (void)count;
+  (void)create;
+  throw Exception("Shared memory queue '" + name +
+                  "' is not supported on this platform");
+#endif
+}
+
+SharedMemoryQueue::Slot *SharedMemoryQueue::slot_at(uint64_t position) const {
+  return reinterpret_cast<Slot *>(segment + round_up(sizeof(Header)) +
+                                  (position % slot_count) * slot_stride);
+}
+
+bool SharedMemoryQueue::push(const void *data, size_t size) {
+  if (size > slot_bytes || header->closed.load()) {
+    return false;
+  }
+  uint64_t pos = header->tail.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot *slot = slot_at(pos);
+    uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq - pos);
+    if (diff == 0) {
+      if (header->tail.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        std::memcpy(payload(slot), data, size);
+        slot->size = size;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        notify_all();
+        return true;
+      }
+    } else if (diff < 0) {
+      // when full overwrite the oldest element, otherwise another thread
+      // is still busy with the slot
+      // pos may be stale and already behind head
+      int64_t queued = static_cast<int64_t>(
+          pos - header->head.load(std::memory_order_acquire));
+      if (queued < static_cast<int64_t>(slot_count) || !discard()) {
+        std::this_thread::yield();
+      }
+      pos = header->tail.load(std::memory_order_relaxed);
+    } else {
+      pos = header->tail.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool SharedMemoryQueue::try_pop(void *buffer, size_t &size) {
+  return take(buffer, slot_bytes, size);
+}
+
+bool SharedMemoryQueue::pop(void *buffer, size_t &size) {
+  return receive(buffer, slot_bytes, size);
+}
+
+void SharedMemoryQueue::close() {
+  header->closed.store(1);
+  notify_all();
+}
+
+bool SharedMemoryQueue::closed() const { return header->closed.load() != 0; }
+
+bool SharedMemoryQueue::empty() const {
+  return header->head.load(std::memory_order_acquire) >=
+         header->tail.load(std::memory_order_acquire);
+}
+
+size_t SharedMemoryQueue::dropped() const {
+  return header->drops.load(std::memory_order_relaxed);
+}
+
+SharedMemoryQueue::Slot *SharedMemoryQueue::claim() {
+  uint64_t pos = header->head.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot *slot = slot_at(pos);
+    uint64_t seq = slot->sequence.load(std::memory_order_acquire);
+    int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+    if (diff == 0) {
+      if (header->head.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        return slot;
+      }
+    } else if (diff < 0) {
+      return nullptr;
+    } else {
+      pos = header->head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void SharedMemoryQueue::release(Slot *slot) {
+  uint64_t pos = slot->sequence.load(std::memory_order_relaxed) - 1;
+  slot->sequence.store(pos + slot_count, std::memory_order_release);
+}
+
+bool SharedMemoryQueue::take(void *buffer, size_t capacity, size_t &size) {
+  Slot *slot = claim();
+  if (slot == nullptr) {
+    return false;
+  }
+  size = slot->size;
+  std::memcpy(buffer, payload(slot), size < capacity ? size : capacity);
+  release(slot);
+  return true;
+}
+
+bool SharedMemoryQueue::receive(void *buffer, size_t capacity, size_t &size) {
+  Consumer consumer(*this);
+  for (;;) {
+    if (take(buffer, capacity, size)) {
+      return true;
+    } else if (!wait_for_data()) {
+      return false;
+    }
+  }
+}
+
+bool SharedMemoryQueue::discard() {
+  Slot *slot = claim();
+  if (slot == nullptr) {
+    return false;
+  }
+  release(slot);
+  header->drops.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+bool SharedMemoryQueue::wait_for_data() {
+  // spin shortly before sleeping, handoffs are usually quick
+  for (size_t i = 0; i < spin_count && empty() && !exit.load(); ++i) {
+    std::this_thread::yield();
+  }
+  for (;;) {
+    if (!empty()) {
+      return true;
+    } else if (exit.load() || closed()) {
+      return false;
+    }
+#ifdef __linux__
+    header->waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t key = header->epoch.load(std::memory_order_acquire);
+    if (empty() && !exit.load() && !closed()) {
+      futex_wait(&header->epoch, key);
+    }
+    header->waiters.fetch_sub(1);
+#endif
+  }
+}
+
+void SharedMemoryQueue::notify_all() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (header->waiters.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  header->epoch.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+  futex_wake_all(&header->epoch);
+#endif
+}
@@ -0,0 +1,182 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SharedMemoryQueue.h                          **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_SHAREDMEMORYQUEUE_H
+#define CANON_SHAREDMEMORYQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace canon {
+namespace utils {
+
+// Drop-oldest queue in a POSIX shared memory segment, so processes on the
+// same host can exchange frames without serializing them. Every slot holds
+// up to slot_size raw bytes, elements are copied in by push and copied out
+// by pop or consume before anybody looks at them, so producers never wait for
+// a consumer.
+//
+// Like MpmcQueue, any number of producers and consumers claim positions with
+// a CAS and synchronize through per-slot sequence numbers, all of which live
+// in the segment. Idle consumers sleep on a futex in the segment, producers
+// only wake them when somebody sleeps. Only supported on Linux, elsewhere the
+// constructors throw.
+//
+//   // process a                       // process b
+//   SharedMemoryQueue q("/frames",     SharedMemoryQueue q("/frames");
+//                       1 << 20, 8);   q.consume([](const void *data,
+//   q.push(frame.data(), frame.size());            size_t size) { ... });
+class SharedMemoryQueue {
+public:
+  // opens the segment with the given name or creates it. throws a
+  // canon::utils::Exception when an existing segment has another geometry.
+  SharedMemoryQueue(const std::string &name, size_t slot_size,
+                    size_t slot_count);
+
+  // opens an existing segment and takes its geometry
+  explicit SharedMemoryQueue(const std::string &name);
+
+  // wakes the blocked consumers of this process with false and unmaps the
+  // segment. the segment itself stays until remove is called.
+  ~SharedMemoryQueue();
+
+  SharedMemoryQueue(const SharedMemoryQueue &) = delete;
+  SharedMemoryQueue &operator=(const SharedMemoryQueue &) = delete;
+
+  // removes the segment name, mappings stay valid until they are unmapped
+  static void remove(const std::string &name);
+
+  // copies size bytes into the queue, dropping the oldest element when it is
+  // full. returns false when size exceeds slot_size or the queue is closed.
+  bool push(const void *data, size_t size);
+
+  template <typename T> bool push(const T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can cross processes");
+    return push(&value, sizeof(T));
+  }
+
+  // copies the oldest element to buffer, which must hold slot_size bytes,
+  // and stores its size
+  bool try_pop(void *buffer, size_t &size);
+
+  // blocks while the queue is empty. returns false when the queue is closed
+  // and empty or this object is being destroyed.
+  bool pop(void *buffer, size_t &size);
+
+  template <typename T> bool pop(T &value) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "only trivially copyable types can cross processes");
+    size_t size = 0;
+    return receive(&value, sizeof(T), size);
+  }
+
+  // copies the oldest element out of the queue and calls
+  // function(const void *data, size_t size) on the copy, so producers never
+  // wait for function. costs an allocation per call, pop into a reused buffer
+  // on hot paths.
+  template <typename Function> bool try_consume(Function function) {
+    std::unique_ptr<char[]> buffer(new char[slot_bytes]);
+    size_t size = 0;
+    if (!take(buffer.get(), slot_bytes, size)) {
+      return false;
+    }
+    function(static_cast<const void *>(buffer.get()), size);
+    return true;
+  }
+
+  // blocking version of try_consume
+  template <typename Function> bool consume(Function function) {
+    std::unique_ptr<char[]> buffer(new char[slot_bytes]);
+    size_t size = 0;
+    if (!receive(buffer.get(), slot_bytes, size)) {
+      return false;
+    }
+    function(static_cast<const void *>(buffer.get()), size);
+    return true;
+  }
+
+  // rejects all further pushes in all processes, consumers still drain the
+  // queued elements
+  void close();
+
+  bool closed() const;
+
+  bool empty() const;
+
+  size_t slot_size() const { return slot_bytes; }
+
+  size_t capacity() const { return slot_count; }
+
+  // elements dropped by all processes because the queue was full
+  size_t dropped() const;
+
+private:
+  struct Header;
+
+  struct Slot {
+    std::atomic<uint64_t> sequence;
+    uint64_t size;
+  };
+
+  // counts the consumers of this process for the destructor
+  class Consumer {
+  public:
+    explicit Consumer(SharedMemoryQueue &queue) : queue(queue) {
+      queue.consumers.fetch_add(1);
+    }
+    ~Consumer() { queue.consumers.fetch_sub(1); }
+
+  private:
+    SharedMemoryQueue &queue;
+  };
+
+  void open(const std::string &name, size_t slot_size, size_t slot_count,
+            bool create);
+  Slot *slot_at(uint64_t position) const;
+  static char *payload(Slot *slot) {
+    return reinterpret_cast<char *>(slot) + sizeof(Slot);
+  }
+  Slot *claim();
+  void release(Slot *slot);
+  // copy out at most capacity bytes of the oldest element and free its slot
+  bool take(void *buffer, size_t capacity, size_t &size);
+  bool receive(void *buffer, size_t capacity, size_t &size);
+  bool discard();
+  bool wait_for_data();
+  void notify_all();
+
+  int fd;
+  char *segment;
+  size_t segment_size;
+  Header *header;
+  size_t slot_bytes;
+  size_t slot_count;
+  size_t slot_stride;
+  std::atomic<bool> exit;
+  std::atomic<size_t> consumers;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_SHAREDMEMORYQUEUE_H */
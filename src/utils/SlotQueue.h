@@ -0,0 +1,177 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SlotQueue.h                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_SLOTQUEUE_H
+#define CANON_SLOTQUEUE_H
+
+#include <utils/EventCount.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Slots and consumer side shared by SpscQueue and MpmcQueue, which only
+// differ in how producers claim a position.
+//
+// Every slot carries a sequence number telling whether it is free for the
+// producer (sequence == position) or filled for the consumer
+// (sequence == position + 1). Consumers claim the head with a CAS, so a
+// producer can drop the oldest element of a full queue by claiming it
+// itself. pop only parks on an EventCount when the queue stays empty, and
+// the destructor wakes all parked consumers with false just like
+// SynchronizedQueue does.
+template <typename Data> class SlotQueue {
+public:
+  SlotQueue(const SlotQueue &) = delete;
+  SlotQueue &operator=(const SlotQueue &) = delete;
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) >=
+           tail.load(std::memory_order_acquire);
+  }
+
+  bool try_pop(Data &popped_value) {
+    Slot *slot = claim();
+    if (slot == nullptr) {
+      return false;
+    }
+    Data *element = reinterpret_cast<Data *>(&slot->storage);
+    popped_value = std::move(*element);
+    release(*slot, element);
+    return true;
+  }
+
+  bool pop(Data &data) {
+    consumers.fetch_add(1);
+    bool result = false;
+    while (!exit.load()) {
+      if (try_pop(data)) {
+        result = true;
+        break;
+      }
+      // spin shortly before parking, handoffs are usually quick
+      for (size_t i = 0; i < spin_count && empty() && !exit.load(); ++i) {
+        std::this_thread::yield();
+      }
+      EventCount::Key key = events.prepare_wait();
+      if (!empty() || exit.load()) {
+        events.cancel_wait();
+        continue;
+      }
+      events.wait(key);
+    }
+    consumers.fetch_sub(1);
+    return result;
+  }
+
+protected:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    typename std::aligned_storage<sizeof(Data), alignof(Data)>::type storage;
+  };
+
+  explicit SlotQueue(size_t maximum_size)
+      : max_size(maximum_size), slots(new Slot[maximum_size]), head(0),
+        tail(0), exit(false), consumers(0) {
+    for (size_t i = 0; i < max_size; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~SlotQueue() {
+    exit.store(true);
+    events.notify_all();
+    // blocked consumers must leave pop before the slots go away
+    while (consumers.load() != 0) {
+      std::this_thread::yield();
+    }
+    while (discard()) {
+    }
+  }
+
+  Slot &slot_at(size_t pos) { return slots[pos % max_size]; }
+
+  // constructs the element in the claimed slot and hands it to the consumers
+  template <typename... Args>
+  void fill(Slot &slot, size_t pos, Args &&... args) {
+    new (&slot.storage) Data(std::forward<Args>(args)...);
+    slot.sequence.store(pos + 1, std::memory_order_release);
+  }
+
+  // claims the oldest element for reading. returns nullptr when empty.
+  Slot *claim() {
+    if (max_size == 0)
+      return nullptr;
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &slot = slot_at(pos);
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          return &slot;
+        }
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // destroys the claimed element and hands the slot back to the producers
+  void release(Slot &slot, Data *element) {
+    size_t pos = slot.sequence.load(std::memory_order_relaxed) - 1;
+    element->~Data();
+    slot.sequence.store(pos + max_size, std::memory_order_release);
+  }
+
+  bool discard() {
+    Slot *slot = claim();
+    if (slot == nullptr) {
+      return false;
+    }
+    release(*slot, reinterpret_cast<Data *>(&slot->storage));
+    return true;
+  }
+
+  enum { cache_line_size = 64, spin_count = 64 };
+
+  const size_t max_size;
+  std::unique_ptr<Slot[]> slots;
+  char head_padding[cache_line_size];
+  std::atomic<size_t> head;
+  char tail_padding[cache_line_size - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail;
+  char state_padding[cache_line_size - sizeof(std::atomic<size_t>)];
+  std::atomic<bool> exit;
+  std::atomic<size_t> consumers;
+  EventCount events;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_SLOTQUEUE_H */
@@ -0,0 +1,144 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SpillFile.cpp                                **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include <utils/SpillFile.h>
+#include <utils/Exception.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using canon::utils::Exception;
+using canon::utils::SpillFile;
+
+namespace {
+
+typedef uint64_t RecordHeader;
+
+enum { alignment = sizeof(RecordHeader) };
+
+// marks the rest of the file as unused, the next record starts at offset 0
+const RecordHeader wrap_marker = ~RecordHeader(0);
+
+size_t align(size_t size) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+SpillFile::SpillFile(const std::string &path, size_t capacity)
+    : path(path), fd(-1), mapping(nullptr), file_size(align(capacity)),
+      head(0), tail(0), used(0), records(0) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd < 0) {
+    throw Exception("Could not create spill file '" + path +
+                    "': " + std::strerror(errno));
+  }
+  if (file_size == 0) {
+    return;
+  }
+  void *mapped = MAP_FAILED;
+  if (ftruncate(fd, file_size) == 0) {
+    mapped = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                  0);
+  }
+  if (mapped == MAP_FAILED) {
+    std::string error = std::strerror(errno);
+    ::close(fd);
+    ::unlink(path.c_str());
+    throw Exception("Could not map spill file '" + path + "': " + error);
+  }
+  mapping = static_cast<char *>(mapped);
+}
+
+SpillFile::~SpillFile() {
+  if (mapping != nullptr) {
+    munmap(mapping, file_size);
+  }
+  ::close(fd);
+  ::unlink(path.c_str());
+}
+
+size_t SpillFile::record_size(size_t size) const {
+  return sizeof(RecordHeader) + align(size);
+}
+
+bool SpillFile::push(const char *data, size_t size) {
+  size_t needed = record_size(size);
+  if (records == 0) {
+    head = tail = used = 0;
+  }
+  if (needed > file_size - used) {
+    return false;
+  }
+  if (tail >= head && needed > file_size - tail) {
+    // not enough room before the end, wrap if the start has room
+    if (needed > head) {
+      return false;
+    }
+    if (file_size - tail >= sizeof(RecordHeader)) {
+      std::memcpy(mapping + tail, &wrap_marker, sizeof(RecordHeader));
+    }
+    used += file_size - tail;
+    tail = 0;
+  } else if (tail < head && needed > head - tail) {
+    return false;
+  }
+  RecordHeader header = size;
+  std::memcpy(mapping + tail, &header, sizeof(RecordHeader));
+  std::memcpy(mapping + tail + sizeof(RecordHeader), data, size);
+  tail += needed;
+  used += needed;
+  ++records;
+  return true;
+}
+
+const char *SpillFile::front() const {
+  return mapping + head + sizeof(RecordHeader);
+}
+
+size_t SpillFile::front_size() const {
+  RecordHeader header;
+  std::memcpy(&header, mapping + head, sizeof(RecordHeader));
+  return header;
+}
+
+void SpillFile::pop() {
+  size_t consumed = record_size(front_size());
+  head += consumed;
+  used -= consumed;
+  if (--records == 0) {
+    head = tail = used = 0;
+  } else {
+    skip_gap();
+  }
+}
+
+void SpillFile::skip_gap() {
+  // the writer wrapped here when the next record did not fit
+  RecordHeader header = 0;
+  if (file_size - head >= sizeof(RecordHeader)) {
+    std::memcpy(&header, mapping + head, sizeof(RecordHeader));
+  }
+  if (file_size - head < sizeof(RecordHeader) || header == wrap_marker) {
+    used -= file_size - head;
+    head = 0;
+  }
+}
@@ -0,0 +1,82 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SpillFile.h                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_SPILLFILE_H
+#define CANON_SPILLFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace canon {
+namespace utils {
+
+// Fixed-size memory-mapped file holding a FIFO of length-prefixed records.
+// Records are appended at the tail and read back from the head, when a
+// record does not fit before the end of the file the tail wraps to the
+// start. The file never grows beyond its capacity, so disk use is capped.
+// Used by the SpillToDisk overflow policy of SynchronizedQueue. Not thread
+// safe, the queue calls it under its lock.
+class SpillFile {
+public:
+  // creates or truncates the file at path. throws a canon::utils::Exception
+  // when it cannot be created or mapped.
+  SpillFile(const std::string &path, size_t capacity);
+
+  // unmaps and removes the file
+  ~SpillFile();
+
+  SpillFile(const SpillFile &) = delete;
+  SpillFile &operator=(const SpillFile &) = delete;
+
+  // appends a record. returns false when it does not fit.
+  bool push(const char *data, size_t size);
+
+  bool empty() const { return records == 0; }
+
+  // number of records
+  size_t size() const { return records; }
+
+  // bytes in use, including record headers and padding
+  size_t bytes() const { return used; }
+
+  size_t capacity() const { return file_size; }
+
+  // the oldest record, undefined when empty
+  const char *front() const;
+  size_t front_size() const;
+
+  void pop();
+
+private:
+  size_t record_size(size_t size) const;
+  void skip_gap();
+
+  std::string path;
+  int fd;
+  char *mapping;
+  size_t file_size;
+  size_t head;
+  size_t tail;
+  size_t used;
+  size_t records;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_SPILLFILE_H */
@@ -0,0 +1,70 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SpscQueue.h                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_SPSCQUEUE_H
+#define CANON_SPSCQUEUE_H
+
+#include <utils/SlotQueue.h>
+
+#include <atomic>
+#include <thread>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Lock-free replacement for SynchronizedQueue when there is exactly one
+// producer and one consumer thread. Keeps the same interface and the same
+// semantics: when max_size is reached the oldest element is overwritten.
+//
+// The slots are those of SlotQueue. The producer drops the oldest element by
+// claiming the head itself, so head is advanced with a CAS while tail is
+// owned by the producer alone.
+template <typename Data> class SpscQueue : public SlotQueue<Data> {
+public:
+  SpscQueue(size_t maximum_size) : SlotQueue<Data>(maximum_size) {}
+
+  SpscQueue &push(Data const &data) { return emplace(data); }
+
+  SpscQueue &push(Data &&data) { return emplace(std::move(data)); }
+
+  template <typename... Args> SpscQueue &emplace(Args &&... args) {
+    if (this->max_size == 0)
+      return *this;
+    size_t pos = this->tail.load(std::memory_order_relaxed);
+    typename SlotQueue<Data>::Slot &slot = this->slot_at(pos);
+    while (slot.sequence.load(std::memory_order_acquire) != pos) {
+      if (pos - this->head.load(std::memory_order_acquire) >=
+          this->max_size) {
+        // full: overwrite the oldest element
+        this->discard();
+      } else {
+        // the consumer is still moving the previous element out of the slot
+        std::this_thread::yield();
+      }
+    }
+    this->fill(slot, pos, std::forward<Args>(args)...);
+    this->tail.store(pos + 1, std::memory_order_release);
+    this->events.notify_one();
+    return *this;
+  }
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_SPSCQUEUE_H */
@@ -18,43 +18,108 @@
 #ifndef CANON_SUBJECT_H
 #define CANON_SUBJECT_H
 
+#include <utils/CopyOnWriteSignal.h>
+#include <utils/UnsynchronizedSignal.h>
+
 #include <boost/signals2/signal.hpp>
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 namespace canon {
 namespace utils {
 
-template <typename Data> class Subject : public boost::noncopyable {
+// Signal engines of a Subject, they double as its threading policy: Signals2
+// and CopyOnWrite may be used from any thread, Unsynchronized from one only.
+// An engine names the Connection type and a Signal<Data> with connect for
+// subscribers taking their own copy, connect_ref for subscribers taking a
+// const reference and operator() for const and rvalue data.
+
+// boost::signals2, locks and bookkeeping on every notification. Every
+// subscriber taking a copy gets one, nothing is moved.
+struct Signals2 {
+  typedef boost::signals2::connection Connection;
+
+  template <typename Data> class Signal {
+  public:
+    Connection connect(std::function<void(Data)> function) {
+      return signal.connect(std::move(function));
+    }
+
+    Connection connect_ref(std::function<void(const Data &)> function) {
+      return signal.connect(std::move(function));
+    }
+
+    void operator()(const Data &data) { signal(data); }
+
+  private:
+    boost::signals2::signal<void(const Data &)> signal;
+  };
+};
+
+// immutable subscriber array, notify is a lock-free load and direct calls
+// while connect and disconnect pay for the synchronization
+struct CopyOnWrite {
+  typedef CopyOnWriteConnection Connection;
+  template <typename Data> using Signal = CopyOnWriteSignal<Data>;
+};
+
+// plain vector of callables for subjects that never leave one thread
+struct Unsynchronized {
+  typedef CopyOnWriteConnection Connection;
+  template <typename Data> using Signal = UnsynchronizedSignal<Data>;
+};
+
+// Notifies all connected subscribers of new data. notify_ref never copies the
+// data for subscribers connected with connect_ref, they see it for the
+// duration of their call. Subscribers connected with connect get a copy.
+// notify takes its own copy first, which engines that can tell the last
+// subscriber move into it.
+template <typename Data, typename Engine = Signals2>
+class Subject : public boost::noncopyable {
 private:
-  typedef boost::signals2::signal<void(Data)> Signal;
+  typedef typename Engine::template Signal<Data> Signal;
 
 public:
-  typedef boost::signals2::connection Connection;
+  typedef typename Engine::Connection Connection;
   typedef Data DataType;
-  typedef std::shared_ptr<Subject<Data>> Ptr;
+  typedef std::shared_ptr<Subject<Data, Engine>> Ptr;
 
   Subject() = default;
   virtual ~Subject() = default;
 
   Connection connect(std::function<void(Data)> subscriber) {
-    return m_Signal.connect(subscriber);
+    return m_Signal.connect(std::move(subscriber));
+  }
+
+  Connection connect_ref(std::function<void(const Data &)> subscriber) {
+    return m_Signal.connect_ref(std::move(subscriber));
   }
 
   void disconnect(Connection subscriber) { subscriber.disconnect(); }
 
-  void notify(Data data) { m_Signal(data); }
+  void notify(Data data) { m_Signal(std::move(data)); }
+
+  void notify_ref(const Data &data) { m_Signal(data); }
 
 private:
   Signal m_Signal;
 };
 
-template <typename Data> class CompositeSubject : public Subject<Data> {
+template <typename Data, typename Engine = Signals2>
+class CompositeSubject : public Subject<Data, Engine> {
+  typedef Subject<Data, Engine> Base;
+
 public:
-  CompositeSubject(const std::vector<typename Subject<Data>::Ptr> subjects)
+  CompositeSubject(const std::vector<typename Base::Ptr> subjects)
       : m_Subjects(subjects) {
     for (auto s : subjects) {
       m_Connections.push_back(
-          s->connect([this](Data data) { this->notify(data); }));
+          s->connect_ref([this](const Data &data) { this->notify_ref(data); }));
     }
   }
 
@@ -65,10 +130,195 @@ public:
   }
 
 private:
-  std::vector<typename Subject<Data>::Ptr> m_Subjects;
-  std::vector<typename Subject<Data>::Connection> m_Connections;
+  std::vector<typename Base::Ptr> m_Subjects;
+  std::vector<typename Base::Connection> m_Connections;
 };
 
+// Merges the notifications of several subjects like CompositeSubject, but
+// without forwarding: every subscriber is connected to each source directly,
+// so a notification runs through a single emission and is not copied on the
+// way. Sources can be added and removed at any time, connected subscribers
+// follow. Connecting and disconnecting costs one connect per source.
+template <typename Data, typename Engine = Signals2>
+class MergedSubject : public boost::noncopyable {
+  class Subscription;
+  class State;
+
+public:
+  typedef Subject<Data, Engine> Source;
+  typedef Data DataType;
+  typedef std::shared_ptr<MergedSubject<Data, Engine>> Ptr;
+
+  class Connection {
+  public:
+    Connection() = default;
+
+    bool connected() const { return subscription && subscription->active; }
+
+    void disconnect() const {
+      std::shared_ptr<State> owner = state.lock();
+      if (owner) {
+        owner->unsubscribe(subscription);
+      }
+    }
+
+  private:
+    friend class MergedSubject;
+
+    Connection(std::shared_ptr<Subscription> subscription,
+               std::weak_ptr<State> state)
+        : subscription(std::move(subscription)), state(std::move(state)) {}
+
+    std::shared_ptr<Subscription> subscription;
+    std::weak_ptr<State> state;
+  };
+
+  explicit MergedSubject(
+      const std::vector<typename Source::Ptr> &sources = {})
+      : state(std::make_shared<State>()) {
+    for (const typename Source::Ptr &source : sources) {
+      add(source);
+    }
+  }
+
+  ~MergedSubject() { state->clear(); }
+
+  // connects all subscribers to source
+  void add(typename Source::Ptr source) { state->add(std::move(source)); }
+
+  // disconnects all subscribers from source
+  void remove(const typename Source::Ptr &source) { state->remove(source); }
+
+  size_t size() const { return state->size(); }
+
+  Connection connect(std::function<void(Data)> subscriber) {
+    return subscribe(std::make_shared<Subscription>(std::move(subscriber)));
+  }
+
+  Connection connect_ref(std::function<void(const Data &)> subscriber) {
+    return subscribe(std::make_shared<Subscription>(std::move(subscriber)));
+  }
+
+  void disconnect(Connection subscriber) { subscriber.disconnect(); }
+
+private:
+  typedef typename Source::Connection SourceConnection;
+
+  class Subscription {
+  public:
+    explicit Subscription(std::function<void(Data)> function)
+        : active(true), value(std::move(function)) {}
+
+    explicit Subscription(std::function<void(const Data &)> function)
+        : active(true), reference(std::move(function)) {}
+
+    void attach(Source &source) {
+      links.emplace_back(&source, reference ? source.connect_ref(reference)
+                                            : source.connect(value));
+    }
+
+    void detach(Source *source) {
+      for (auto link = links.begin(); link != links.end(); ++link) {
+        if (link->first == source) {
+          link->second.disconnect();
+          links.erase(link);
+          return;
+        }
+      }
+    }
+
+    void detach() {
+      for (auto &link : links) {
+        link.second.disconnect();
+      }
+      links.clear();
+      active = false;
+    }
+
+    std::atomic<bool> active;
+
+  private:
+    // exactly one of them is set
+    std::function<void(Data)> value;
+    std::function<void(const Data &)> reference;
+    std::vector<std::pair<Source *, SourceConnection>> links;
+  };
+
+  // everything the connections need to reach, guarded by one mutex that
+  // only connect, disconnect, add and remove take
+  class State {
+  public:
+    void add(typename Source::Ptr source) {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &subscription : subscriptions) {
+        subscription->attach(*source);
+      }
+      sources.push_back(std::move(source));
+    }
+
+    void remove(const typename Source::Ptr &source) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = std::find(sources.begin(), sources.end(), source);
+      if (found == sources.end()) {
+        return;
+      }
+      for (auto &subscription : subscriptions) {
+        subscription->detach(source.get());
+      }
+      sources.erase(found);
+    }
+
+    size_t size() {
+      std::lock_guard<std::mutex> lock(mutex);
+      return sources.size();
+    }
+
+    void subscribe(const std::shared_ptr<Subscription> &subscription) {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &source : sources) {
+        subscription->attach(*source);
+      }
+      subscriptions.push_back(subscription);
+    }
+
+    void unsubscribe(const std::shared_ptr<Subscription> &subscription) {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found =
+          std::find(subscriptions.begin(), subscriptions.end(), subscription);
+      if (found != subscriptions.end()) {
+        subscription->detach();
+        subscriptions.erase(found);
+      }
+    }
+
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto &subscription : subscriptions) {
+        subscription->detach();
+      }
+      subscriptions.clear();
+      sources.clear();
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<typename Source::Ptr> sources;
+    std::vector<std::shared_ptr<Subscription>> subscriptions;
+  };
+
+  Connection subscribe(std::shared_ptr<Subscription> subscription) {
+    state->subscribe(subscription);
+    return Connection(std::move(subscription), state);
+  }
+
+  std::shared_ptr<State> state;
+};
+
+// one immutable payload shared by all subscribers, connect hands out another
+// reference and connect_ref not even that
+template <typename T, typename Engine = Signals2>
+using SharedSubject = Subject<std::shared_ptr<const T>, Engine>;
+
 } // namespace utils
 } // namespace canon
 
@@ -0,0 +1,174 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/SynchronizedPriorityQueue.h                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_SYNCHRONIZEDPRIORITYQUEUE_H
+#define CANON_SYNCHRONIZEDPRIORITYQUEUE_H
+
+#include <utils/RingBuffer.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Bounded queue that pops the element with the highest priority first and
+// elements of equal priority in FIFO order. When max_size is reached the
+// lowest priority element is dropped, the oldest one among equals. A new
+// element that has a lower priority than everything queued is dropped right
+// away. Shutdown behaves like SynchronizedQueue: the destructor wakes all
+// waiting consumers with false.
+//
+// Elements are kept in one FIFO per distinct priority, so push and pop cost
+// O(log p) for p distinct priorities in the queue.
+template <typename Data, typename Priority = int,
+          typename Compare = std::less<Priority>>
+class SynchronizedPriorityQueue {
+public:
+  typedef std::mutex Mutex;
+  typedef std::unique_lock<Mutex> Lock;
+  typedef std::condition_variable ConditionVariable;
+
+  SynchronizedPriorityQueue(size_t maximum_size)
+      : count(0), max_size(maximum_size), exit(false), consumers(0),
+        drops(0) {}
+
+  ~SynchronizedPriorityQueue() {
+    {
+      Lock lock(mutex);
+      exit.store(true);
+    }
+    condition.notify_all();
+    // blocked consumers must leave before the mutex goes away
+    while (consumers.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  SynchronizedPriorityQueue &push(const Priority &priority,
+                                  Data const &data) {
+    return emplace(priority, data);
+  }
+
+  SynchronizedPriorityQueue &push(const Priority &priority, Data &&data) {
+    return emplace(priority, std::move(data));
+  }
+
+  template <typename... Args>
+  SynchronizedPriorityQueue &emplace(const Priority &priority,
+                                     Args &&... args) {
+    Lock lock(mutex);
+    if (count >= max_size) {
+      if (count == 0 || compare(priority, groups.begin()->first)) {
+        // the new element has the lowest priority
+        drops.fetch_add(1, std::memory_order_relaxed);
+        return *this;
+      }
+      pop_from(groups.begin());
+      drops.fetch_add(1, std::memory_order_relaxed);
+    }
+    auto group = groups.find(priority);
+    if (group == groups.end()) {
+      group = groups.emplace(std::piecewise_construct,
+                             std::forward_as_tuple(priority),
+                             std::forward_as_tuple())
+                  .first;
+    }
+    group->second.emplace_back(std::forward<Args>(args)...);
+    ++count;
+    lock.unlock();
+    condition.notify_one();
+    return *this;
+  }
+
+  bool empty() const {
+    Lock lock(mutex);
+    return count == 0;
+  }
+
+  size_t size() const {
+    Lock lock(mutex);
+    return count;
+  }
+
+  // number of elements dropped because the queue was full
+  size_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+  bool try_pop(Data &popped_value) {
+    Lock lock(mutex);
+    if (count == 0) {
+      return false;
+    }
+    take(popped_value);
+    return true;
+  }
+
+  bool pop(Data &data) {
+    consumers.fetch_add(1);
+    bool result = false;
+    {
+      Lock lock(mutex);
+      while (count == 0 && !exit.load()) {
+        condition.wait(lock);
+      }
+      if (!exit.load()) {
+        take(data);
+        result = true;
+      }
+    }
+    consumers.fetch_sub(1);
+    return result;
+  }
+
+private:
+  typedef std::map<Priority, RingBuffer<Data>, Compare> Groups;
+
+  void take(Data &data) {
+    auto highest = std::prev(groups.end());
+    data = std::move(highest->second.front());
+    pop_from(highest);
+  }
+
+  void pop_from(typename Groups::iterator group) {
+    group->second.pop_front();
+    --count;
+    if (group->second.empty()) {
+      groups.erase(group);
+    }
+  }
+
+  Groups groups;
+  size_t count;
+  Compare compare;
+  mutable Mutex mutex;
+  ConditionVariable condition;
+  size_t max_size;
+  std::atomic<bool> exit;
+  std::atomic<size_t> consumers;
+  std::atomic<size_t> drops;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_SYNCHRONIZEDPRIORITYQUEUE_H */
@@ -18,80 +18,911 @@
 #ifndef CANON_SYNCHRONIZEDQUEUE_H
 #define CANON_SYNCHRONIZEDQUEUE_H
 
+#include <utils/QueueStatistics.h>
+#include <utils/RingBuffer.h>
+#include <utils/SpillFile.h>
+
+#include <algorithm>
 #include <condition_variable>
+#include <functional>
 #include <mutex>
-#include <queue>
 #include <atomic>
+#include <chrono>
+#include <cstring>
 #include <thread>
+#include <type_traits>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace canon {
 namespace utils {
 
-template <typename Data> class SynchronizedQueue {
+// What push does when the queue holds max_size elements. The policy is a
+// template parameter of SynchronizedQueue and resolved at compile time.
+
+// drop the oldest queued element to make room (live data, the default)
+struct DropOldest {};
+
+// silently drop the element being pushed
+struct DropNewest {};
+
+// do not insert the element and tell the producer via try_push
+struct Reject {};
+
+// block the producer until a consumer makes room, optionally with a timeout
+// after which the element is dropped
+class BlockProducer {
+public:
+  BlockProducer() : bounded(false), timeout(0) {}
+
+  template <typename Rep, typename Period>
+  explicit BlockProducer(const std::chrono::duration<Rep, Period> &timeout)
+      : bounded(true),
+        timeout(std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)) {
+  }
+
+  bool bounded;
+  std::chrono::nanoseconds timeout;
+};
+
+// write the elements past the in-memory bound to a memory-mapped file of at
+// most max_bytes and read them back in order as consumers make room. pushes
+// that do not fit on disk either are rejected. serialize appends the bytes
+// of an element to the buffer, deserialize rebuilds it. copies of the policy
+// share the file, so spilled() can be queried through the one passed in.
+template <typename Data> class SpillToDisk {
+public:
+  typedef std::function<void(const Data &, std::vector<char> &)> Serializer;
+  typedef std::function<Data(const char *, size_t)> Deserializer;
+
+  SpillToDisk(const std::string &path, size_t max_bytes, Serializer serialize,
+              Deserializer deserialize)
+      : file(std::make_shared<SpillFile>(path, max_bytes)),
+        serialize(std::move(serialize)), deserialize(std::move(deserialize)) {
+  }
+
+  // number of elements on disk
+  size_t spilled() const { return file->size(); }
+
+  // disk space in use
+  size_t spilled_bytes() const { return file->bytes(); }
+
+  bool empty() const { return file->empty(); }
+
+  // weight is the size the queue accounts the element with once it is read
+  // back, stamp the expiry stamp it had when it was pushed. both are stored
+  // in front of the serialized bytes.
+  template <typename Stamp>
+  bool write(const Data &data, size_t weight, const Stamp &stamp) {
+    static_assert(std::is_trivially_copyable<Stamp>::value,
+                  "stamps are stored as raw bytes");
+    buffer.resize(sizeof(weight) + stamp_size<Stamp>());
+    std::memcpy(buffer.data(), &weight, sizeof(weight));
+    std::memcpy(buffer.data() + sizeof(weight), &stamp, stamp_size<Stamp>());
+    serialize(data, buffer);
+    return file->push(buffer.data(), buffer.size());
+  }
+
+  size_t next_weight() const {
+    size_t weight;
+    std::memcpy(&weight, file->front(), sizeof(weight));
+    return weight;
+  }
+
+  template <typename Stamp> Data read(Stamp &stamp) {
+    const size_t header = sizeof(size_t) + stamp_size<Stamp>();
+    std::memcpy(&stamp, file->front() + sizeof(size_t), stamp_size<Stamp>());
+    Data data =
+        deserialize(file->front() + header, file->front_size() - header);
+    file->pop();
+    return data;
+  }
+
+private:
+  // NoExpiry stamps take no space
+  template <typename Stamp> static constexpr size_t stamp_size() {
+    return std::is_empty<Stamp>::value ? 0 : sizeof(Stamp);
+  }
+
+  std::shared_ptr<SpillFile> file;
+  Serializer serialize;
+  Deserializer deserialize;
+  // reused for every element, the queue serializes under its lock
+  std::vector<char> buffer;
+};
+
+// How consumers wait for data. They busy-poll for spins iterations, then
+// yield their time slice for yields iterations and only then block on the
+// condition variable. Spinning trades CPU time for handoff latency.
+struct WaitStrategy {
+  WaitStrategy(size_t spins = 0, size_t yields = 0)
+      : spins(spins), yields(yields) {}
+
+  // block right away, the default
+  static WaitStrategy blocking() { return WaitStrategy(); }
+
+  // spin and yield for a while before blocking
+  static WaitStrategy adaptive(size_t spins = 2000, size_t yields = 50) {
+    return WaitStrategy(spins, yields);
+  }
+
+  static void relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+  }
+
+  size_t spins;
+  size_t yields;
+};
+
+// Limit of a SynchronizedQueue with ByteBound, which bounds the total
+// payload size of the queued elements instead of their count. size_of
+// returns the size of an element in bytes, it is called once per push before
+// the queue is locked. An element larger than the whole budget is never
+// inserted.
+template <typename Data> struct ByteBudget {
+  typedef std::function<size_t(const Data &)> SizeFunction;
+
+  ByteBudget(size_t bytes, SizeFunction size_of)
+      : bytes(bytes), size_of(std::move(size_of)) {}
+
+  size_t bytes;
+  SizeFunction size_of;
+};
+
+// What max_size of a SynchronizedQueue counts. The policy is a template
+// parameter, the queue is constructed from its Limit and asks it for the
+// weight of every pushed element. Like the expiry policy it stores a Stamp
+// next to every element and keeps track of the load under the queue lock.
+
+// the default: every element weighs one, the ring is allocated up front.
+// the load is the queue size, nothing is stored.
+struct CountBound {
+  typedef size_t Limit;
+  struct Stamp {};
+  enum { preallocates = true };
+
+  explicit CountBound(size_t) {}
+
+  static size_t max_size(size_t limit) { return limit; }
+
+  template <typename Data> size_t weigh(const Data &) const { return 1; }
+
+  void add(Stamp &, size_t) {}
+  void remove(const Stamp &) {}
+  size_t load(size_t count) const { return count; }
+};
+
+// elements weigh their payload bytes, see ByteBudget. the ring grows as
+// needed.
+template <typename Data> class ByteBound {
+public:
+  typedef ByteBudget<Data> Limit;
+  struct Stamp {
+    size_t weight;
+  };
+  enum { preallocates = false };
+
+  explicit ByteBound(const Limit &limit) : size_of(limit.size_of), bytes(0) {}
+
+  static size_t max_size(const Limit &limit) { return limit.bytes; }
+
+  size_t weigh(const Data &data) const { return size_of(data); }
+
+  void add(Stamp &stamp, size_t weight) {
+    stamp.weight = weight;
+    bytes += weight;
+  }
+
+  void remove(const Stamp &stamp) { bytes -= stamp.weight; }
+
+  size_t load(size_t) const { return bytes; }
+
+private:
+  typename Limit::SizeFunction size_of;
+  // of all queued elements
+  size_t bytes;
+};
+
+// Whether queued elements expire. The policy is a template parameter of
+// SynchronizedQueue, it stores a Stamp next to every element.
+
+// elements never expire, the default. compiled away completely.
+struct NoExpiry {
+  struct Stamp {};
+  typedef int TimePoint;
+
+  static constexpr bool expires() { return false; }
+  static TimePoint now() { return 0; }
+  void stamp(Stamp &) const {}
+  bool expired(const Stamp &, TimePoint) const { return false; }
+};
+
+// elements expire ttl after they were pushed. consumers skip and count
+// expired elements. Clock is any type with the interface of the std::chrono
+// clocks, e.g. a manual clock in tests. it must be monotonic, since only the
+// oldest elements are checked.
+template <typename Clock = std::chrono::steady_clock> class TimeToLive {
+public:
+  typedef typename Clock::time_point TimePoint;
+
+  struct Stamp {
+    TimePoint deadline;
+  };
+
+  template <typename Rep, typename Period>
+  explicit TimeToLive(const std::chrono::duration<Rep, Period> &ttl)
+      : ttl(std::chrono::duration_cast<typename Clock::duration>(ttl)) {}
+
+  static constexpr bool expires() { return true; }
+  static TimePoint now() { return Clock::now(); }
+  void stamp(Stamp &stamp) const { stamp.deadline = Clock::now() + ttl; }
+
+  bool expired(const Stamp &stamp, TimePoint now) const {
+    return stamp.deadline <= now;
+  }
+
+private:
+  typename Clock::duration ttl;
+};
+
+enum class PushStatus {
+  Pushed,        // the element was inserted
+  DroppedOldest, // the element was inserted, the oldest one dropped
+  DroppedNewest, // the element was dropped
+  Rejected,      // the element was not inserted
+  Timeout,       // the element was dropped after blocking for the timeout
+  Closed,        // the queue was closed, the element was not inserted
+  Spilled        // the element was written to the spill file
+};
+
+enum class PopStatus {
+  Popped,  // an element was popped
+  Timeout, // the queue stayed empty until the deadline
+  Shutdown // the queue is closed and drained or being destroyed
+};
+
+// Statistics is NoStatistics or QueueStatistics, see QueueStatistics.h.
+// Expiry is NoExpiry or TimeToLive. Bound is CountBound or ByteBound.
+// Allocator provides the ring storage, it is rebound to the internal element
+// type.
+template <typename Data, typename Overflow = DropOldest,
+          typename Statistics = NoStatistics, typename Expiry = NoExpiry,
+          typename Bound = CountBound,
+          typename Allocator = std::allocator<Data>>
+class SynchronizedQueue {
 public:
   typedef std::mutex Mutex;
   typedef std::unique_lock<Mutex> Lock;
   typedef std::condition_variable ConditionVariable;
+  typedef Overflow OverflowPolicy;
+  typedef Statistics StatisticsPolicy;
+  typedef Expiry ExpiryPolicy;
+  typedef Bound BoundPolicy;
 
-  SynchronizedQueue(size_t maximum_size) : max_size(maximum_size), exit(false) {}
+  // the limit is the maximum element count, or a ByteBudget under ByteBound
+  SynchronizedQueue(typename Bound::Limit limit, Overflow policy = Overflow(),
+                    WaitStrategy wait = WaitStrategy::blocking(),
+                    Expiry expiry = Expiry())
+      : queue(Bound::preallocates
+                  ? std::min<size_t>(Bound::max_size(limit),
+                                     preallocation_limit)
+                  : 0),
+        policies(policy, expiry, limit), exit(false), closing(false), callers(0), blocked_producers(0),
+        drops(0), expirations(0), wait_strategy(wait),
+        available(0), waiting_consumers(0), next_listener(0),
+        high_watermark(no_watermark),
+        low_watermark(0), above(false), newest(typename Expiry::Stamp()) {}
 
   ~SynchronizedQueue() {
-    exit.store(true);
+    {
+      // waiters check exit under the lock, so none of them can miss it
+      Lock lock(mutex);
+      exit.store(true);
+    }
     condition.notify_all();
-    Lock lock(mutex);
+    not_full.notify_all();
+    // blocked threads must leave before the mutex goes away
+    while (callers.load() != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  // rejects all further pushes with PushStatus::Closed and wakes blocked
+  // producers. consumers still get the queued elements, pop returns false
+  // only once the queue is empty.
+  void close() {
+    {
+      Lock lock(mutex);
+      closing.store(true);
+    }
+    condition.notify_all();
+    not_full.notify_all();
   }
 
+  bool closed() const { return closing.load(); }
+
   SynchronizedQueue& push(Data const &data) {
-    if(max_size == 0) return *this;
+    try_push(data);
+    return *this;
+  }
+
+  SynchronizedQueue& push(Data &&data) {
+    try_push(std::move(data));
+    return *this;
+  }
+
+  // constructs the element in place, so large messages are never copied
+  template <typename... Args> SynchronizedQueue &emplace(Args &&... args) {
+    try_emplace(std::forward<Args>(args)...);
+    return *this;
+  }
+
+  PushStatus try_push(Data const &data) { return place(weigh(data), data); }
+
+  PushStatus try_push(Data &&data) {
+    size_t size = weigh(data);
+    return place(size, std::move(data));
+  }
+
+  template <typename... Args> PushStatus try_emplace(Args &&... args) {
+    return place_weighed(bound(), std::forward<Args>(args)...);
+  }
+
+  // pushes all elements with a single lock round-trip
+  template <typename InputIt>
+  SynchronizedQueue &push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return *this;
+    Caller caller(callers, blocks(overflow()));
     Lock lock(mutex);
-    if (queue.size() >= max_size) {
-      queue.pop();
+    expire();
+    for (; first != last && !closing.load(); ++first) {
+      size_t size = weigh(*first);
+      PushStatus status = make_room(lock, overflow(), size);
+      if (inserts(status)) {
+        insert(size, *first);
+      } else if (status == PushStatus::Spilled) {
+        spill(overflow(), size, *first);
+      }
     }
-    queue.push(data);
+    pushed();
+    bool wake = waiting_consumers != 0;
     lock.unlock();
-    condition.notify_one();
+    if (wake) {
+      condition.notify_all();
+    }
     return *this;
   }
 
+  // number of elements the overflow policy dropped or rejected so far
+  size_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+  // number of expired elements consumers skipped so far
+  size_t expired() const {
+    return expirations.load(std::memory_order_relaxed);
+  }
+
+  // lock-free access to the statistics, e.g. statistics().snapshot()
+  const Statistics &statistics() const { return stats(); }
+
+  // a queue holding only expired elements is empty, consumers would skip
+  // them all
   bool empty() const {
+    return available.load(std::memory_order_acquire) == 0 ||
+           (Expiry::expires() &&
+            expiry().expired(newest.load(std::memory_order_relaxed),
+                             expiry().now()));
+  }
+
+  // listeners are called under the queue lock after every push that
+  // inserted data. they must not call back into the queue. returns the key
+  // for remove_listener. used by QueueSelector, so a queue can be added to
+  // several selectors.
+  size_t add_listener(std::function<void()> listener) {
     Lock lock(mutex);
-    return queue.empty();
+    listeners.emplace_back(next_listener, std::move(listener));
+    return next_listener++;
+  }
+
+  void remove_listener(size_t key) {
+    Lock lock(mutex);
+    for (auto it = listeners.begin(); it != listeners.end(); ++it) {
+      if (it->first == key) {
+        listeners.erase(it);
+        return;
+      }
+    }
+  }
+
+  // once the load (elements, or bytes under a ByteBound) reaches high,
+  // above_watermark() turns true and callback(true) is called. both stay
+  // until the load falls to low, then callback(false) is called. low must be
+  // below high. like the push listener the callback runs under the queue
+  // lock and must not call back into the queue. expired elements count until
+  // the next push or pop drops them.
+  void set_watermarks(size_t high, size_t low,
+                      std::function<void(bool)> callback = nullptr) {
+    Lock lock(mutex);
+    high_watermark = high;
+    low_watermark = low;
+    watermark_listener = std::move(callback);
+    watermarks();
+  }
+
+  // lets producers poll for backpressure without taking the lock
+  bool above_watermark() const {
+    return above.load(std::memory_order_relaxed);
   }
 
   bool try_pop(Data &popped_value) {
     Lock lock(mutex);
-    if (queue.empty()) {
+    if (!has_data()) {
       return false;
     }
-    popped_value = queue.front();
-    queue.pop();
+    take(popped_value);
     return true;
   }
 
   bool pop(Data &data) {
+    Caller caller(callers);
+    spin();
     Lock lock(mutex);
-    while (queue.empty()) {
-      if (exit.load()) {
-        return false;
-      }
-      condition.wait(lock);
-    }
-    if(queue.empty() || exit.load()){
+    if (!wait_for_data(lock)) {
       return false;
     } else {
-      data = queue.front();
-      queue.pop();
+      take(data);
       return true;
     }
   }
 
+  template <typename Rep, typename Period>
+  PopStatus pop_for(Data &data,
+                    const std::chrono::duration<Rep, Period> &timeout) {
+    return pop_until(data, std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <typename Clock, typename Duration>
+  PopStatus pop_until(Data &data,
+                      const std::chrono::time_point<Clock, Duration> &deadline) {
+    Caller caller(callers);
+    spin();
+    Lock lock(mutex);
+    while (!has_data() && !stopping()) {
+      if (wait_until(lock, deadline) == std::cv_status::timeout &&
+          !has_data() && !stopping()) {
+        return PopStatus::Timeout;
+      }
+    }
+    if (exit.load() || queue.empty()) {
+      return PopStatus::Shutdown;
+    }
+    take(data);
+    return PopStatus::Popped;
+  }
+
+  // blocks while the queue is empty, then moves up to max_n elements to out.
+  // returns the number of elements popped, 0 when the queue shuts down.
+  template <typename OutputIt> size_t pop_bulk(OutputIt out, size_t max_n) {
+    if (max_n == 0)
+      return 0;
+    Caller caller(callers);
+    spin();
+    Lock lock(mutex);
+    if (!wait_for_data(lock)) {
+      return 0;
+    }
+    size_t popped = 0;
+    for (; popped < max_n && !queue.empty(); ++popped) {
+      *out = std::move(queue.front().data);
+      ++out;
+      pop_oldest();
+    }
+    removed(overflow());
+    return popped;
+  }
+
+  // blocks while the queue is empty, then moves all elements at once and
+  // appends them to out. returns false when the queue shuts down.
+  bool drain(std::vector<Data> &out) {
+    Caller caller(callers);
+    spin();
+    Lock lock(mutex);
+    if (!wait_for_data(lock)) {
+      return false;
+    }
+    out.reserve(out.size() + queue.size());
+    for (; !queue.empty(); pop_oldest()) {
+      out.push_back(std::move(queue.front().data));
+    }
+    removed(overflow());
+    return true;
+  }
+
 private:
-  std::queue<Data> queue;
+  // storage for up to this many elements is allocated on construction, larger
+  // queues grow once until they first reach max_size
+  enum { preallocation_limit = 65536 };
+
+  static const size_t no_watermark = static_cast<size_t>(-1);
+
+  struct InPlace {};
+
+  // counts the calling thread in callers for its lifetime
+  class Caller {
+  public:
+    explicit Caller(std::atomic<size_t> &count, bool counted = true)
+        : count(counted ? &count : nullptr) {
+      if (this->count != nullptr) {
+        this->count->fetch_add(1);
+      }
+    }
+
+    Caller(const Caller &) = delete;
+    Caller &operator=(const Caller &) = delete;
+
+    ~Caller() {
+      if (count != nullptr) {
+        count->fetch_sub(1);
+      }
+    }
+
+  private:
+    std::atomic<size_t> *count;
+  };
+
+  // the stamps are empty unless statistics, expiry or a ByteBound are
+  // compiled in
+  struct Entry : public Statistics::Stamp,
+                 public Expiry::Stamp,
+                 public Bound::Stamp {
+    template <typename... Args>
+    Entry(InPlace, Args &&... args) : data(std::forward<Args>(args)...) {}
+
+    Data data;
+  };
+
+  // the policies are base classes, so the empty ones share the storage of
+  // max_size instead of taking a padded byte each
+  struct Policies : Overflow, Statistics, Expiry, Bound {
+    Policies(const Overflow &overflow, const Expiry &expiry,
+             const typename Bound::Limit &limit)
+        : Overflow(overflow), Expiry(expiry), Bound(limit),
+          max_size(Bound::max_size(limit)) {}
+
+    // in elements, or in bytes under a ByteBound
+    size_t max_size;
+  };
+
+  Overflow &overflow() { return policies; }
+  Statistics &stats() { return policies; }
+  const Statistics &stats() const { return policies; }
+  const Expiry &expiry() const { return policies; }
+  // keeps the load
+  Bound &bound() { return policies; }
+  const Bound &bound() const { return policies; }
+
+  // element count or payload bytes, depending on how the queue is bounded
+  size_t weigh(const Data &data) const { return bound().weigh(data); }
+
+  // every element weighs the same, construct it in place under the lock
+  template <typename... Args>
+  PushStatus place_weighed(const CountBound &, Args &&... args) {
+    return place(1, std::forward<Args>(args)...);
+  }
+
+  // the weight is only known once the element exists
+  template <typename Policy, typename... Args>
+  PushStatus place_weighed(const Policy &, Args &&... args) {
+    Data data(std::forward<Args>(args)...);
+    size_t size = weigh(data);
+    return place(size, std::move(data));
+  }
+
+  // element count or payload bytes of the queued elements
+  size_t load() const { return bound().load(queue.size()); }
+
+  bool fits(size_t size) const { return load() + size <= policies.max_size; }
+
+  template <typename... Args> PushStatus place(size_t size, Args &&... args) {
+    Caller caller(callers, blocks(overflow()));
+    Lock lock(mutex);
+    if (closing.load()) {
+      return PushStatus::Closed;
+    }
+    // expired elements take no room from new ones
+    expire();
+    PushStatus status = make_room(lock, overflow(), size);
+    if (status == PushStatus::Spilled) {
+      return spill(overflow(), size, std::forward<Args>(args)...);
+    } else if (inserts(status)) {
+      insert(size, std::forward<Args>(args)...);
+      pushed();
+      // skip the notification when nobody waits
+      bool wake = waiting_consumers != 0;
+      lock.unlock();
+      if (wake) {
+        condition.notify_one();
+      }
+    }
+    return status;
+  }
+
+  template <typename... Args> void insert(size_t size, Args &&... args) {
+    queue.emplace_back(InPlace(), std::forward<Args>(args)...);
+    expiry().stamp(queue.back());
+    newest.store(static_cast<const typename Expiry::Stamp &>(queue.back()),
+                 std::memory_order_relaxed);
+    inserted(size);
+  }
+
+  // inserts an element read back from the spill file with the expiry stamp
+  // it got when it was pushed, time on disk counts towards its deadline
+  void restore(size_t size, const typename Expiry::Stamp &stamp, Data &&data) {
+    queue.emplace_back(InPlace(), std::move(data));
+    static_cast<typename Expiry::Stamp &>(queue.back()) = stamp;
+    inserted(size);
+  }
+
+  void inserted(size_t size) {
+    bound().add(queue.back(), size);
+    stats().pushed(queue.back(), queue.size(), load());
+    available.store(queue.size(), std::memory_order_release);
+    watermarks();
+  }
+
+  void pop_oldest() {
+    typename Statistics::Stamp stamp = queue.front();
+    pop_front();
+    stats().popped(stamp, queue.size(), load());
+    watermarks();
+  }
+
+  void pop_front() {
+    bound().remove(queue.front());
+    queue.pop_front();
+    available.store(queue.size(), std::memory_order_relaxed);
+  }
+
+  // edge-triggered with hysteresis, a compare per call while nothing changes
+  void watermarks() {
+    if (load() >= high_watermark) {
+      if (!above.load(std::memory_order_relaxed)) {
+        above.store(true, std::memory_order_relaxed);
+        if (watermark_listener) {
+          watermark_listener(true);
+        }
+      }
+    } else if (load() <= low_watermark &&
+               above.load(std::memory_order_relaxed)) {
+      above.store(false, std::memory_order_relaxed);
+      if (watermark_listener) {
+        watermark_listener(false);
+      }
+    }
+  }
+
+  static bool inserts(PushStatus status) {
+    return status == PushStatus::Pushed || status == PushStatus::DroppedOldest;
+  }
+
+  PushStatus refuse(PushStatus status) {
+    drops.fetch_add(1, std::memory_order_relaxed);
+    stats().dropped(queue.size(), load());
+    return status;
+  }
+
+  // make_room and removed are resolved by the overflow policy type. size is
+  // the weight of the element about to be inserted.
+
+  PushStatus make_room(Lock &, DropOldest &, size_t size) {
+    if (fits(size)) {
+      return PushStatus::Pushed;
+    } else if (size > policies.max_size) {
+      return refuse(PushStatus::Rejected);
+    }
+    // under a byte budget a large element may push out several small ones
+    do {
+      pop_front();
+      refuse(PushStatus::DroppedOldest);
+    } while (!fits(size));
+    return PushStatus::DroppedOldest;
+  }
+
+  PushStatus make_room(Lock &, DropNewest &, size_t size) {
+    return fits(size) ? PushStatus::Pushed : refuse(PushStatus::DroppedNewest);
+  }
+
+  PushStatus make_room(Lock &, Reject &, size_t size) {
+    return fits(size) ? PushStatus::Pushed : refuse(PushStatus::Rejected);
+  }
+
+  PushStatus make_room(Lock &lock, BlockProducer &policy, size_t size) {
+    if (fits(size)) {
+      return PushStatus::Pushed;
+    } else if (size > policies.max_size) {
+      return refuse(PushStatus::Rejected);
+    }
+    // wake consumers for elements a push_range inserted before blocking
+    if (waiting_consumers != 0) {
+      condition.notify_all();
+    }
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + policy.timeout;
+    ++blocked_producers;
+    while (!fits(size) && !stopping()) {
+      if (!policy.bounded) {
+        not_full.wait(lock);
+      } else if (not_full.wait_until(lock, deadline) ==
+                     std::cv_status::timeout &&
+                 !fits(size)) {
+        --blocked_producers;
+        return refuse(PushStatus::Timeout);
+      }
+    }
+    --blocked_producers;
+    return stopping() ? PushStatus::Closed : PushStatus::Pushed;
+  }
+
+  // once anything is on disk new elements go there as well to keep the order
+  PushStatus make_room(Lock &, SpillToDisk<Data> &policy, size_t size) {
+    if (policy.empty() && fits(size)) {
+      return PushStatus::Pushed;
+    } else if (size > policies.max_size) {
+      return refuse(PushStatus::Rejected);
+    }
+    return PushStatus::Spilled;
+  }
+
+  // only called when make_room returned Spilled
+  template <typename Policy, typename... Args>
+  PushStatus spill(Policy &, size_t, Args &&...) {
+    return PushStatus::Rejected;
+  }
+
+  PushStatus spill(SpillToDisk<Data> &policy, size_t size, const Data &data) {
+    typename Expiry::Stamp stamp;
+    expiry().stamp(stamp);
+    if (!policy.write(data, size, stamp)) {
+      return refuse(PushStatus::Rejected);
+    }
+    newest.store(stamp, std::memory_order_relaxed);
+    return PushStatus::Spilled;
+  }
+
+  template <typename... Args>
+  PushStatus spill(SpillToDisk<Data> &policy, size_t size, Args &&... args) {
+    return spill(policy, size, static_cast<const Data &>(
+                                   Data(std::forward<Args>(args)...)));
+  }
+
+  // whether a push may block, only then it has to be counted as a caller
+  template <typename Policy> static bool blocks(Policy &) { return false; }
+
+  static bool blocks(BlockProducer &) { return true; }
+
+  template <typename Policy> void removed(Policy &) {}
+
+  void removed(BlockProducer &) {
+    if (blocked_producers != 0) {
+      not_full.notify_all();
+    }
+  }
+
+  // reads spilled elements back as room becomes available. the memory part
+  // never runs empty while elements are on disk, so consumers never wait for
+  // them.
+  void removed(SpillToDisk<Data> &policy) {
+    while (!policy.empty() && (queue.empty() || fits(policy.next_weight()))) {
+      size_t size = policy.next_weight();
+      typename Expiry::Stamp stamp;
+      Data data = policy.read(stamp);
+      restore(size, stamp, std::move(data));
+    }
+  }
+
+  void take(Data &data) {
+    data = std::move(queue.front().data);
+    pop_oldest();
+    removed(overflow());
+  }
+
+  void pushed() {
+    for (auto &listener : listeners) {
+      listener.second();
+    }
+  }
+
+  // the spinning phase of the wait strategy, runs without the lock
+  void spin() {
+    for (size_t i = 0; i < wait_strategy.spins && idle(); ++i) {
+      WaitStrategy::relax();
+    }
+    for (size_t i = 0; i < wait_strategy.yields && idle(); ++i) {
+      std::this_thread::yield();
+    }
+  }
+
+  bool idle() const {
+    return available.load(std::memory_order_acquire) == 0 && !stopping();
+  }
+
+  bool stopping() const { return exit.load() || closing.load(); }
+
+  // drops expired elements from the front. deadlines grow towards the back,
+  // so the first live element ends the scan.
+  void expire() {
+    if (Expiry::expires() && !queue.empty()) {
+      typename Expiry::TimePoint now = expiry().now();
+      size_t count = 0;
+      for (; !queue.empty() && expiry().expired(queue.front(), now); ++count) {
+        pop_front();
+        stats().dropped(queue.size(), load());
+      }
+      if (count != 0) {
+        watermarks();
+        expirations.fetch_add(count, std::memory_order_relaxed);
+        removed(overflow());
+      }
+    }
+  }
+
+  bool has_data() {
+    expire();
+    return !queue.empty();
+  }
+
+  bool wait_for_data(Lock &lock) {
+    while (!has_data()) {
+      if (stopping()) {
+        return false;
+      }
+      ++waiting_consumers;
+      condition.wait(lock);
+      --waiting_consumers;
+    }
+    return !exit.load();
+  }
+
+  template <typename Clock, typename Duration>
+  std::cv_status
+  wait_until(Lock &lock,
+             const std::chrono::time_point<Clock, Duration> &deadline) {
+    ++waiting_consumers;
+    std::cv_status status = condition.wait_until(lock, deadline);
+    --waiting_consumers;
+    return status;
+  }
+
+  RingBuffer<Entry, typename std::allocator_traits<
+                        Allocator>::template rebind_alloc<Entry>> queue;
   mutable Mutex mutex;
   ConditionVariable condition;
-  size_t max_size;
+  ConditionVariable not_full;
+  Policies policies;
   std::atomic<bool> exit;
+  std::atomic<bool> closing;
+  // threads in calls that may block, the destructor waits for them to leave
+  std::atomic<size_t> callers;
+  size_t blocked_producers;
+  std::atomic<size_t> drops;
+  std::atomic<size_t> expirations;
+  const WaitStrategy wait_strategy;
+  // queue size readable without the lock, for spinning consumers
+  std::atomic<size_t> available;
+  size_t waiting_consumers;
+  std::vector<std::pair<size_t, std::function<void()>>> listeners;
+  size_t next_listener;
+  size_t high_watermark;
+  size_t low_watermark;
+  std::atomic<bool> above;
+  // stamp of the newest pushed element, in memory or on disk
+  std::atomic<typename Expiry::Stamp> newest;
+  std::function<void(bool)> watermark_listener;
 };
 
 } // namespace utils
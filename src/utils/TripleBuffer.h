@@ -0,0 +1,115 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/TripleBuffer.h                               **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_TRIPLEBUFFER_H
+#define CANON_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace canon {
+namespace utils {
+
+// Hands the newest value from one producer to one consumer when older values
+// do not matter, e.g. camera frames. Both sides are wait-free, nothing is
+// allocated and values are never copied by the buffer itself.
+//
+// The producer owns one buffer, the consumer owns one and the third sits in
+// the middle. publish() swaps the producer buffer with the middle one,
+// update() swaps the middle one with the consumer buffer if the producer
+// published since the last update.
+//
+//   producer:                        consumer:
+//   render(buffer.input());          if (buffer.update()) {
+//   buffer.publish();                  show(buffer.output());
+//                                    }
+template <typename T> class TripleBuffer {
+public:
+  TripleBuffer() : write_index(0), middle(1), read_index(2) {}
+
+  explicit TripleBuffer(const T &initial)
+      : write_index(0), middle(1), read_index(2) {
+    for (auto &slot : slots) {
+      slot.value = initial;
+    }
+  }
+
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // the producer buffer. it still holds whatever value the consumer left in
+  // it, so it can be reused without reallocating.
+  T &input() { return slots[write_index].value; }
+
+  // makes the input buffer the newest value
+  void publish() {
+    write_index =
+        middle.exchange(write_index | fresh, std::memory_order_acq_rel) &
+        index_mask;
+  }
+
+  void write(const T &value) {
+    input() = value;
+    publish();
+  }
+
+  void write(T &&value) {
+    input() = std::move(value);
+    publish();
+  }
+
+  // takes the newest value if there is one. returns whether output() changed.
+  bool update() {
+    if ((middle.load(std::memory_order_relaxed) & fresh) == 0) {
+      return false;
+    }
+    read_index =
+        middle.exchange(read_index, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+
+  // whether the producer published since the last update
+  bool updated() const {
+    return (middle.load(std::memory_order_relaxed) & fresh) != 0;
+  }
+
+  // the consumer buffer, stable until the next update
+  T &output() { return slots[read_index].value; }
+
+  const T &output() const { return slots[read_index].value; }
+
+private:
+  enum { cache_line_size = 64, index_mask = 3, fresh = 4 };
+
+  struct Slot {
+    T value;
+    char padding[cache_line_size];
+  };
+
+  Slot slots[3];
+  uint8_t write_index;
+  char write_padding[cache_line_size];
+  std::atomic<uint8_t> middle;
+  char middle_padding[cache_line_size];
+  uint8_t read_index;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_TRIPLEBUFFER_H */
@@ -0,0 +1,180 @@
+/********************************************************************
+**                                                                 **
+** File   : src/utils/UnsynchronizedSignal.h                       **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#ifndef CANON_UNSYNCHRONIZEDSIGNAL_H
+#define CANON_UNSYNCHRONIZEDSIGNAL_H
+
+#include <utils/CopyOnWriteSignal.h>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace canon {
+namespace utils {
+
+// Signal for subjects that live in a single thread. Emitting is a loop over
+// a plain vector of callables without any synchronization. Subscribers may
+// connect and disconnect during an emission, the vector is only changed once
+// the outermost emission returned. Like with CopyOnWriteSignal, subscribers
+// connected during an emission are first called by the next one and
+// disconnected ones are not called anymore. Subscribers taking a copy get one
+// each, nothing is moved.
+//
+// The connections are CopyOnWriteConnection handles kept next to the
+// callables. An emission only looks at them once a subscriber was
+// disconnected while it runs. All calls must come from one thread.
+template <typename Data> class UnsynchronizedSignal {
+public:
+  typedef CopyOnWriteConnection Connection;
+  typedef std::function<void(const Data &)> Function;
+
+  UnsynchronizedSignal() : core(std::make_shared<Core>()) {}
+
+  UnsynchronizedSignal(const UnsynchronizedSignal &) = delete;
+  UnsynchronizedSignal &operator=(const UnsynchronizedSignal &) = delete;
+
+  Connection connect(std::function<void(Data)> function) {
+    return core->add([function](const Data &data) { function(data); });
+  }
+
+  Connection connect_ref(Function function) {
+    return core->add(std::move(function));
+  }
+
+  void operator()(const Data &data) const {
+    Core &state = *core;
+    Emission emission(state);
+    size_t count = state.calls.size();
+    size_t i = 0;
+    for (; i < count && !state.changed; ++i) {
+      state.calls[i](data);
+    }
+    // somebody disconnected during the emission
+    for (; i < count; ++i) {
+      if (state.links[i]->active.load(std::memory_order_relaxed)) {
+        state.calls[i](data);
+      }
+    }
+  }
+
+private:
+  typedef std::shared_ptr<Connection::Link> Link;
+
+  class Core : public Connection::Owner,
+               public std::enable_shared_from_this<Core> {
+  public:
+    Core() : emitting(0), changed(false) {}
+
+    ~Core() {
+      for (Link &link : links) {
+        link->active.store(false);
+      }
+      for (Link &link : pending_links) {
+        link->active.store(false);
+      }
+    }
+
+    Connection add(Function function) {
+      Link link = std::make_shared<Connection::Link>();
+      Connection connection(link, this->shared_from_this());
+      // a running emission may be calling into calls
+      if (emitting != 0) {
+        pending_calls.push_back(std::move(function));
+        pending_links.push_back(std::move(link));
+      } else {
+        calls.push_back(std::move(function));
+        links.push_back(std::move(link));
+      }
+      return connection;
+    }
+
+    void remove(Connection::Link *link) override {
+      link->active.store(false);
+      changed = true;
+      if (emitting == 0) {
+        flush();
+      }
+    }
+
+    // applies the changes deferred during emissions
+    void flush() {
+      if (changed) {
+        compact(calls, links);
+        compact(pending_calls, pending_links);
+        changed = false;
+      }
+      for (size_t i = 0; i < pending_calls.size(); ++i) {
+        calls.push_back(std::move(pending_calls[i]));
+        links.push_back(std::move(pending_links[i]));
+      }
+      pending_calls.clear();
+      pending_links.clear();
+    }
+
+    std::vector<Function> calls;
+    std::vector<Link> links;
+    std::vector<Function> pending_calls;
+    std::vector<Link> pending_links;
+    size_t emitting;
+    // a subscriber was disconnected since the last flush
+    bool changed;
+
+  private:
+    // drops the disconnected subscribers
+    static void compact(std::vector<Function> &functions,
+                        std::vector<Link> &handles) {
+      size_t kept = 0;
+      for (size_t i = 0; i < functions.size(); ++i) {
+        if (!handles[i]->active.load(std::memory_order_relaxed)) {
+          continue;
+        }
+        if (kept != i) {
+          functions[kept] = std::move(functions[i]);
+          handles[kept] = std::move(handles[i]);
+        }
+        ++kept;
+      }
+      functions.resize(kept);
+      handles.resize(kept);
+    }
+  };
+
+  // tracks nested emissions, even when a subscriber throws
+  class Emission {
+  public:
+    explicit Emission(Core &core) : core(core) { ++core.emitting; }
+
+    ~Emission() {
+      if (--core.emitting == 0) {
+        core.flush();
+      }
+    }
+
+  private:
+    Core &core;
+  };
+
+  std::shared_ptr<Core> core;
+};
+
+} // namespace utils
+} // namespace canon
+
+#endif /* !CANON_UNSYNCHRONIZEDSIGNAL_H */
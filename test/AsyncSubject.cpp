@@ -0,0 +1,275 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/AsyncSubject.cpp                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/AsyncSubject.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ::canon::utils::Executor;
+using ::canon::utils::QueueStatistics;
+using ::canon::utils::Reject;
+
+typedef ::canon::utils::AsyncSubject<int> AsyncSubject;
+
+// waits up to a few seconds for the condition to hold
+bool eventually(std::function<bool()> condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// a subscriber that blocks in its first call until released
+class Blocker {
+public:
+  Blocker() : entered(false), calls(0), gate(release.get_future().share()) {}
+
+  void operator()(int data) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      history.push_back(data);
+    }
+    if (!entered.exchange(true)) {
+      gate.wait();
+    }
+    ++calls;
+  }
+
+  std::vector<int> received() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return history;
+  }
+
+  std::atomic<bool> entered;
+  std::atomic<int> calls;
+  std::promise<void> release;
+
+private:
+  std::shared_future<void> gate;
+  std::mutex mutex;
+  std::vector<int> history;
+};
+
+TEST(AsyncSubjectTest, Deliver) {
+  Executor executor(2);
+  std::mutex mutex;
+  std::vector<int> history;
+  AsyncSubject subject(executor, 16);
+  auto connection = subject.connect([&](int data) {
+    std::lock_guard<std::mutex> lock(mutex);
+    history.push_back(data);
+  });
+  EXPECT_TRUE(connection.connected());
+  for (int i = 0; i < 10; ++i) {
+    subject.notify(i);
+  }
+  EXPECT_TRUE(eventually([&]() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return history.size() == 10;
+  }));
+  std::lock_guard<std::mutex> lock(mutex);
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}), history);
+}
+
+TEST(AsyncSubjectTest, NotifyAddress) {
+  Executor executor(1);
+  std::atomic<int> sum(0);
+  AsyncSubject subject(executor, 16);
+  subject.connect([&sum](int data) { sum += data; });
+  // notify is not overloaded, like Subject::notify
+  std::function<void(int)> bound =
+      std::bind(&AsyncSubject::notify, &subject, std::placeholders::_1);
+  bound(1);
+  const int value = 2;
+  subject.notify_ref(value);
+  EXPECT_TRUE(eventually([&]() { return sum.load() == 3; }));
+}
+
+TEST(AsyncSubjectTest, SlowSubscriber) {
+  Executor executor(2);
+  Blocker slow;
+  std::atomic<int> fast(0);
+  AsyncSubject subject(executor, 4);
+  auto slow_connection = subject.connect(std::ref(slow));
+  subject.connect([&fast](int) { ++fast; });
+  subject.notify(0);
+  ASSERT_TRUE(eventually([&]() { return slow.entered.load(); }));
+  // neither the producer nor the fast subscriber wait for the slow one
+  for (int i = 1; i <= 10; ++i) {
+    subject.notify(i);
+    ASSERT_TRUE(eventually([&]() { return fast.load() == i + 1; }));
+  }
+  // the slow mailbox kept the newest four
+  EXPECT_EQ(6u, slow_connection.dropped());
+  EXPECT_EQ(6u, slow_connection.statistics().snapshot().drops);
+  slow.release.set_value();
+  ASSERT_TRUE(eventually([&]() { return slow.calls.load() == 5; }));
+  EXPECT_EQ(std::vector<int>({0, 7, 8, 9, 10}), slow.received());
+}
+
+TEST(AsyncSubjectTest, Overflow) {
+  Executor executor(1);
+  Blocker slow;
+  ::canon::utils::AsyncSubject<int, Reject> subject(executor, 2);
+  auto connection = subject.connect(std::ref(slow));
+  subject.notify(0);
+  ASSERT_TRUE(eventually([&]() { return slow.entered.load(); }));
+  for (int i = 1; i <= 5; ++i) {
+    subject.notify(i);
+  }
+  EXPECT_EQ(3u, connection.dropped());
+  slow.release.set_value();
+  ASSERT_TRUE(eventually([&]() { return slow.calls.load() == 3; }));
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), slow.received());
+}
+
+TEST(AsyncSubjectTest, Disconnect) {
+  Executor executor(1);
+  std::atomic<int> calls(0);
+  AsyncSubject subject(executor, 16);
+  auto connection = subject.connect([&calls](int) { ++calls; });
+  subject.notify(1);
+  ASSERT_TRUE(eventually([&]() { return calls.load() == 1; }));
+  subject.disconnect(connection);
+  EXPECT_FALSE(connection.connected());
+  subject.notify(2);
+  executor.join();
+  EXPECT_EQ(1, calls.load());
+}
+
+TEST(AsyncSubjectTest, DisconnectFromSubscriber) {
+  Executor executor(1);
+  std::atomic<int> calls(0);
+  AsyncSubject subject(executor, 16);
+  AsyncSubject::Connection connection;
+  connection = subject.connect([&](int) {
+    ++calls;
+    connection.disconnect();
+  });
+  subject.notify(1);
+  subject.notify(2);
+  executor.join();
+  EXPECT_EQ(1, calls.load());
+  EXPECT_FALSE(connection.connected());
+}
+
+TEST(AsyncSubjectTest, DisconnectBlockedProducer) {
+  Executor executor(1);
+  std::promise<void> release;
+  std::shared_future<void> gate = release.get_future().share();
+  // keeps the only worker busy, nothing gets delivered
+  executor.execute([gate]() { gate.wait(); });
+  ::canon::utils::AsyncSubject<int, ::canon::utils::BlockProducer> subject(
+      executor, 1);
+  auto connection = subject.connect([](int) {});
+  subject.notify(1);
+  std::future<void> producer =
+      std::async(std::launch::async, [&subject]() { subject.notify(2); });
+  EXPECT_EQ(std::future_status::timeout,
+            producer.wait_for(std::chrono::milliseconds(10)));
+  connection.disconnect();
+  EXPECT_EQ(std::future_status::ready,
+            producer.wait_for(std::chrono::seconds(5)));
+  release.set_value();
+  executor.join();
+}
+
+TEST(AsyncSubjectTest, DeleteSubject) {
+  Executor executor(1);
+  Blocker slow;
+  AsyncSubject::Connection connection;
+  std::future<void> released;
+  {
+    AsyncSubject subject(executor, 16);
+    connection = subject.connect(std::ref(slow));
+    subject.notify(1);
+    subject.notify(2);
+    ASSERT_TRUE(eventually([&]() { return slow.entered.load(); }));
+    released = std::async(std::launch::async, [&slow]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      slow.release.set_value();
+    });
+    // waits for the running delivery, the second one is discarded
+  }
+  EXPECT_EQ(1, slow.calls.load());
+  EXPECT_FALSE(connection.connected());
+  released.get();
+  executor.join();
+  EXPECT_EQ(1, slow.calls.load());
+}
+
+TEST(AsyncSubjectTest, ConcurrentDisconnect) {
+  Executor executor(2);
+  std::atomic<int> calls(0);
+  AsyncSubject subject(executor, 1024);
+  subject.connect([&calls](int) { ++calls; });
+  std::atomic<bool> done(false);
+  std::vector<std::future<void>> churners;
+  for (int t = 0; t < 2; ++t) {
+    churners.push_back(std::async(std::launch::async, [&]() {
+      std::vector<int> payload(16, 1);
+      while (!done.load()) {
+        auto connection = subject.connect([payload](int) {
+          std::this_thread::yield();
+          EXPECT_EQ(16u, payload.size());
+        });
+        std::this_thread::yield();
+        connection.disconnect();
+      }
+    }));
+  }
+  for (int i = 0; i < 1000; ++i) {
+    subject.notify(i);
+  }
+  done.store(true);
+  for (auto &churner : churners) {
+    churner.get();
+  }
+  EXPECT_TRUE(eventually([&]() { return calls.load() == 1000; }));
+}
+
+TEST(AsyncSubjectTest, Latency) {
+  Executor executor(1);
+  std::atomic<int> calls(0);
+  AsyncSubject subject(executor, 16);
+  auto connection = subject.connect([&calls](int) { ++calls; });
+  subject.notify(1);
+  subject.notify(2);
+  ASSERT_TRUE(eventually([&]() { return calls.load() == 2; }));
+  QueueStatistics::Snapshot snapshot = connection.statistics().snapshot();
+  EXPECT_EQ(2u, snapshot.pops);
+  EXPECT_EQ(0u, snapshot.drops);
+  EXPECT_LT(0u, snapshot.dwell_percentile(1.0));
+}
+
+}
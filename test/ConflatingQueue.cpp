@@ -0,0 +1,118 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/ConflatingQueue.cpp                               **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/ConflatingQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+#include <string>
+
+namespace {
+
+typedef ::canon::utils::ConflatingQueue<std::string, int> Queue;
+
+TEST(ConflatingQueueTest, Constructor) {
+  EXPECT_NO_THROW(Queue(0));
+  EXPECT_NO_THROW(Queue(1));
+}
+
+TEST(ConflatingQueueTest, Empty) {
+  EXPECT_TRUE(Queue(0).empty());
+  EXPECT_TRUE(Queue(0).push("a", 1).empty());
+  EXPECT_FALSE(Queue(1).push("a", 1).empty());
+}
+
+TEST(ConflatingQueueTest, Conflation) {
+  std::string key;
+  int value = 0;
+  Queue q(10);
+  q.push("elbow", 1).push("wrist", 1).push("elbow", 2).push("elbow", 3);
+  EXPECT_EQ(2u, q.size());
+  EXPECT_EQ(2u, q.conflated());
+  // elbow keeps its position and carries the newest value
+  ASSERT_TRUE(q.try_pop(key, value));
+  EXPECT_EQ("elbow", key);
+  EXPECT_EQ(3, value);
+  q.push("elbow", 4);
+  ASSERT_TRUE(q.try_pop(key, value));
+  EXPECT_EQ("wrist", key);
+  EXPECT_EQ(1, value);
+  ASSERT_TRUE(q.try_pop(key, value));
+  EXPECT_EQ("elbow", key);
+  EXPECT_EQ(4, value);
+  EXPECT_FALSE(q.try_pop(key, value));
+}
+
+TEST(ConflatingQueueTest, DropOldestKey) {
+  int value = 0;
+  Queue q(2);
+  q.push("a", 1).push("b", 2).push("a", 3).push("c", 4);
+  EXPECT_EQ(1u, q.dropped());
+  ASSERT_TRUE(q.try_pop(value));
+  EXPECT_EQ(2, value);
+  ASSERT_TRUE(q.try_pop(value));
+  EXPECT_EQ(4, value);
+}
+
+TEST(ConflatingQueueTest, Drain) {
+  Queue q(10);
+  q.push("a", 1).push("b", 2).push("a", 3);
+  std::vector<std::pair<std::string, int>> out;
+  EXPECT_EQ(2u, q.drain(out));
+  ASSERT_EQ(2u, out.size());
+  EXPECT_EQ("a", out[0].first);
+  EXPECT_EQ(3, out[0].second);
+  EXPECT_EQ("b", out[1].first);
+  EXPECT_EQ(2, out[1].second);
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(0u, q.drain(out));
+}
+
+TEST(ConflatingQueueTest, LockingOnEmpty) {
+  Queue q(1);
+  std::future<int> first_pop = std::async(std::launch::async, [&q]() {
+    int value = 0;
+    q.pop(value);
+    return value;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.push("a", 7);
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ(7, first_pop.get());
+}
+
+TEST(ConflatingQueueTest, Destruction) {
+  std::unique_ptr<Queue> q(new Queue(1));
+  Queue *queue = q.get();
+  std::future<bool> first_pop = std::async(std::launch::async, [queue]() {
+    int value = 0;
+    return queue->pop(value);
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_FALSE(first_pop.get());
+}
+
+}
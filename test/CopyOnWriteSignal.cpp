@@ -0,0 +1,276 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/CopyOnWriteSignal.cpp                             **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/CopyOnWriteSignal.h"
+#include "utils/Subject.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ::canon::utils::CopyOnWrite;
+using ::canon::utils::ReadCopyUpdate;
+
+typedef ::canon::utils::Subject<int, CopyOnWrite> Subject;
+typedef ::canon::utils::CompositeSubject<int, CopyOnWrite> CompositeSubject;
+
+TEST(CopyOnWriteSignalTest, Connect) {
+  Subject subject;
+  std::vector<int> history;
+  auto connection = subject.connect([&history](int i) { history.push_back(i); });
+  EXPECT_TRUE(connection.connected());
+  subject.notify(1);
+  subject.notify(2);
+  EXPECT_EQ(std::vector<int>({1, 2}), history);
+}
+
+TEST(CopyOnWriteSignalTest, Disconnect) {
+  Subject subject;
+  std::vector<int> history;
+  auto first = subject.connect([&history](int i) { history.push_back(i); });
+  auto second = subject.connect([&history](int i) { history.push_back(-i); });
+  subject.notify(1);
+  first.disconnect();
+  EXPECT_FALSE(first.connected());
+  EXPECT_TRUE(second.connected());
+  subject.notify(2);
+  subject.disconnect(second);
+  EXPECT_FALSE(second.connected());
+  subject.notify(3);
+  EXPECT_EQ(std::vector<int>({1, -1, -2}), history);
+  // disconnecting twice or a default connection does nothing
+  EXPECT_NO_THROW(first.disconnect());
+  EXPECT_NO_THROW(Subject::Connection().disconnect());
+  EXPECT_FALSE(Subject::Connection().connected());
+}
+
+TEST(CopyOnWriteSignalTest, DeleteSubject) {
+  Subject::Connection connection;
+  {
+    Subject subject;
+    connection = subject.connect([](int) {});
+    EXPECT_TRUE(connection.connected());
+  }
+  EXPECT_FALSE(connection.connected());
+  EXPECT_NO_THROW(connection.disconnect());
+}
+
+TEST(CopyOnWriteSignalTest, DisconnectWhileNotifying) {
+  Subject subject;
+  std::vector<int> history;
+  Subject::Connection second;
+  // the first subscriber disconnects itself and the next one, which must not
+  // be called anymore during the running notification
+  Subject::Connection first = subject.connect([&](int i) {
+    history.push_back(i);
+    first.disconnect();
+    second.disconnect();
+  });
+  second = subject.connect([&history](int i) { history.push_back(-i); });
+  subject.notify(1);
+  subject.notify(2);
+  EXPECT_EQ(std::vector<int>({1}), history);
+}
+
+TEST(CopyOnWriteSignalTest, ConnectWhileNotifying) {
+  Subject subject;
+  int calls = 0;
+  subject.connect([&](int) {
+    ++calls;
+    subject.connect([&calls](int) { ++calls; });
+  });
+  // subscribers connected during a notification see the next one
+  subject.notify(1);
+  EXPECT_EQ(1, calls);
+  subject.notify(2);
+  EXPECT_EQ(3, calls);
+}
+
+// counts how often it gets copied
+struct Payload {
+  static size_t copies;
+  Payload() = default;
+  Payload(const Payload &) { ++copies; }
+  Payload(Payload &&) = default;
+};
+size_t Payload::copies = 0;
+
+TEST(CopyOnWriteSignalTest, MoveToLast) {
+  ::canon::utils::Subject<Payload, CopyOnWrite> subject;
+  subject.connect([](Payload) {});
+  subject.connect_ref([](const Payload &) {});
+  subject.connect([](Payload) {});
+  Payload::copies = 0;
+  // the first by-value subscriber gets a copy, the last one the original
+  subject.notify(Payload());
+  EXPECT_EQ(1u, Payload::copies);
+  // lvalues are never moved from
+  Payload payload;
+  Payload::copies = 0;
+  subject.notify_ref(payload);
+  EXPECT_EQ(2u, Payload::copies);
+  // notify copies the lvalue once and moves the copy to the last one
+  Payload::copies = 0;
+  subject.notify(payload);
+  EXPECT_EQ(2u, Payload::copies);
+}
+
+TEST(CopyOnWriteSignalTest, Composite) {
+  auto a = std::make_shared<Subject>();
+  auto b = std::make_shared<Subject>();
+  CompositeSubject composite({a, b});
+  std::vector<int> history;
+  composite.connect([&history](int i) { history.push_back(i); });
+  a->notify(1);
+  b->notify(2);
+  EXPECT_EQ(std::vector<int>({1, 2}), history);
+}
+
+TEST(CopyOnWriteSignalTest, Merged) {
+  auto a = std::make_shared<Subject>();
+  auto b = std::make_shared<Subject>();
+  ::canon::utils::MergedSubject<int, CopyOnWrite> merged({a});
+  std::vector<int> history;
+  // a subscriber disconnecting itself while its source notifies
+  ::canon::utils::MergedSubject<int, CopyOnWrite>::Connection connection;
+  connection = merged.connect([&](int i) {
+    history.push_back(i);
+    if (i == 3) {
+      connection.disconnect();
+    }
+  });
+  merged.add(b);
+  a->notify(1);
+  b->notify(2);
+  b->notify(3);
+  a->notify(4);
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), history);
+  EXPECT_FALSE(connection.connected());
+}
+
+TEST(CopyOnWriteSignalTest, Churn) {
+  // emitters iterate arrays while writers keep replacing and retiring them
+  Subject subject;
+  std::atomic<long> sum(0);
+  subject.connect([&sum](int i) { sum.fetch_add(i); });
+  std::atomic<bool> done(false);
+  std::vector<std::future<void>> writers;
+  for (int t = 0; t < 2; ++t) {
+    writers.push_back(std::async(std::launch::async, [&]() {
+      std::vector<int> payload(16, 1);
+      while (!done.load()) {
+        std::vector<Subject::Connection> connections;
+        for (int i = 0; i < 4; ++i) {
+          connections.push_back(subject.connect_ref([payload](const int &) {
+            // get preempted while the array is in use
+            std::this_thread::yield();
+            EXPECT_EQ(16u, payload.size());
+          }));
+        }
+        for (auto &connection : connections) {
+          connection.disconnect();
+        }
+      }
+    }));
+  }
+  std::vector<std::future<void>> emitters;
+  for (int t = 0; t < 3; ++t) {
+    emitters.push_back(std::async(std::launch::async, [&subject]() {
+      for (int i = 0; i < 20000; ++i) {
+        subject.notify(1);
+      }
+    }));
+  }
+  for (auto &emitter : emitters) {
+    emitter.get();
+  }
+  done.store(true);
+  for (auto &writer : writers) {
+    writer.get();
+  }
+  EXPECT_EQ(60000, sum.load());
+}
+
+TEST(CopyOnWriteSignalTest, Reclaim) {
+  std::vector<int> deleted;
+  ReadCopyUpdate rcu;
+  ReadCopyUpdate::Ticket ticket = rcu.enter();
+  // retired while a reader is inside
+  rcu.retire([&deleted]() { deleted.push_back(1); });
+  EXPECT_TRUE(deleted.empty());
+  rcu.leave(ticket);
+  // the next retire finds the old readers gone
+  rcu.retire([&deleted]() { deleted.push_back(2); });
+  EXPECT_EQ(std::vector<int>({1, 2}), deleted);
+  // whatever is left goes with the destructor
+  {
+    ReadCopyUpdate other;
+    other.enter();
+    other.retire([&deleted]() { deleted.push_back(3); });
+  }
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), deleted);
+}
+
+TEST(CopyOnWriteSignalTest, ReaderSpansRetires) {
+  std::vector<int> deleted;
+  ReadCopyUpdate rcu;
+  // a reader entering between a publish and its retire sees the new
+  // structure, which the next retire hands over while it is still in use
+  ReadCopyUpdate::Ticket ticket = rcu.enter();
+  rcu.retire([&deleted]() { deleted.push_back(1); });
+  rcu.retire([&deleted]() { deleted.push_back(2); });
+  EXPECT_TRUE(deleted.empty());
+  rcu.leave(ticket);
+  rcu.retire([&deleted]() { deleted.push_back(3); });
+  EXPECT_EQ(std::vector<int>({1, 2, 3}), deleted);
+}
+
+TEST(CopyOnWriteSignalTest, Concurrent) {
+  Subject subject;
+  std::atomic<int> sum(0);
+  subject.connect([&sum](int i) { sum.fetch_add(i); });
+  std::atomic<bool> done(false);
+  std::future<void> writer = std::async(std::launch::async, [&]() {
+    while (!done.load()) {
+      Subject::Connection c = subject.connect([](int) {});
+      c.disconnect();
+    }
+  });
+  std::vector<std::future<void>> notifiers;
+  for (int t = 0; t < 2; ++t) {
+    notifiers.push_back(std::async(std::launch::async, [&subject]() {
+      for (int i = 0; i < 10000; ++i) {
+        subject.notify(1);
+      }
+    }));
+  }
+  for (auto &notifier : notifiers) {
+    notifier.get();
+  }
+  done.store(true);
+  writer.get();
+  EXPECT_EQ(20000, sum.load());
+}
+
+}
@@ -0,0 +1,70 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/EventCount.cpp                                    **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/EventCount.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+
+namespace {
+
+using ::canon::utils::EventCount;
+
+TEST(EventCountTest, CancelWait) {
+  EventCount events;
+  EventCount::Key key = events.prepare_wait();
+  events.cancel_wait();
+  // nobody waits, notify does not advance the epoch
+  events.notify_all();
+  EXPECT_EQ(key, events.prepare_wait());
+  events.cancel_wait();
+}
+
+TEST(EventCountTest, NotifyAfterPrepare) {
+  EventCount events;
+  // a notification between prepare_wait and wait must not get lost
+  EventCount::Key key = events.prepare_wait();
+  events.notify_one();
+  events.wait(key);
+  SUCCEED();
+}
+
+TEST(EventCountTest, WakeWaiter) {
+  EventCount events;
+  std::atomic<bool> flag(false);
+  std::future<void> waiter = std::async(std::launch::async, [&]() {
+    while (!flag.load()) {
+      EventCount::Key key = events.prepare_wait();
+      if (flag.load()) {
+        events.cancel_wait();
+        break;
+      }
+      events.wait(key);
+    }
+  });
+  std::future_status status = waiter.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  flag.store(true);
+  events.notify_one();
+  status = waiter.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+}
+
+}
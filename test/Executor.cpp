@@ -0,0 +1,144 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/Executor.cpp                                      **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/Executor.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using ::canon::utils::Executor;
+
+TEST(ExecutorTest, Constructor) {
+  EXPECT_NO_THROW(Executor());
+  EXPECT_EQ(2u, Executor(2).size());
+  EXPECT_NO_THROW(Executor(2, true));
+}
+
+TEST(ExecutorTest, Submit) {
+  Executor executor(2);
+  std::future<int> result = executor.submit([]() { return 42; });
+  EXPECT_EQ(42, result.get());
+  std::future<void> failure =
+      executor.submit([]() { throw std::runtime_error("failure"); });
+  EXPECT_THROW(failure.get(), std::runtime_error);
+}
+
+TEST(ExecutorTest, ExecuteRange) {
+  std::atomic<int> sum(0);
+  std::vector<Executor::Task> tasks;
+  for (int i = 1; i <= 100; ++i) {
+    tasks.push_back([&sum, i]() { sum += i; });
+  }
+  Executor executor(3);
+  EXPECT_TRUE(executor.execute_range(tasks.begin(), tasks.end()));
+  executor.join();
+  EXPECT_EQ(5050, sum.load());
+}
+
+TEST(ExecutorTest, SubmitRange) {
+  std::vector<std::function<int()>> functions;
+  for (int i = 0; i < 10; ++i) {
+    functions.push_back([i]() { return i * i; });
+  }
+  Executor executor(2);
+  auto results = executor.submit_range(functions.begin(), functions.end());
+  ASSERT_EQ(10u, results.size());
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(i * i, results[i].get());
+  }
+}
+
+TEST(ExecutorTest, NestedTasks) {
+  // all subtasks land in one deque, the other workers have to steal them
+  std::atomic<int> count(0);
+  Executor executor(4);
+  executor.execute([&executor, &count]() {
+    for (int i = 0; i < 1000; ++i) {
+      executor.execute([&count]() { ++count; });
+    }
+  });
+  executor.join();
+  EXPECT_EQ(1000, count.load());
+}
+
+TEST(ExecutorTest, Close) {
+  Executor executor(1);
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  std::atomic<int> count(0);
+  executor.execute([opened]() { opened.wait(); });
+  for (int i = 0; i < 10; ++i) {
+    executor.execute([&count]() { ++count; });
+  }
+  executor.close();
+  EXPECT_TRUE(executor.closed());
+  EXPECT_FALSE(executor.execute([&count]() { ++count; }));
+  std::future<int> rejected = executor.submit([]() { return 1; });
+  EXPECT_THROW(rejected.get(), std::future_error);
+  // queued tasks still run
+  gate.set_value();
+  executor.join();
+  EXPECT_EQ(10, count.load());
+}
+
+TEST(ExecutorTest, CloseWhileExecuting) {
+  // every task execute accepted runs, no matter how it races with close
+  for (int round = 0; round < 200; ++round) {
+    std::atomic<int> accepted(0);
+    std::atomic<int> ran(0);
+    Executor executor(2);
+    std::future<void> producer = std::async(std::launch::async, [&]() {
+      while (executor.execute([&ran]() { ++ran; })) {
+        ++accepted;
+      }
+    });
+    std::this_thread::yield();
+    executor.join();
+    producer.get();
+    EXPECT_EQ(accepted.load(), ran.load());
+  }
+}
+
+TEST(ExecutorTest, DestructionDiscardsQueuedTasks) {
+  std::unique_ptr<Executor> executor(new Executor(1));
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+  std::promise<void> started;
+  executor->execute([opened, &started]() {
+    started.set_value();
+    opened.wait();
+  });
+  std::future<int> discarded = executor->submit([]() { return 1; });
+  started.get_future().wait();
+  std::thread destroy([&executor]() { executor.reset(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  // the destructor waits for the running task
+  gate.set_value();
+  destroy.join();
+  EXPECT_THROW(discarded.get(), std::future_error);
+}
+
+}
@@ -0,0 +1,279 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/MpmcQueue.cpp                                     **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/MpmcQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+
+namespace {
+
+typedef ::canon::utils::MpmcQueue<int> Queue;
+
+TEST(MpmcQueueTest, Constructor) {
+  // constructor does not throw
+  EXPECT_NO_THROW(Queue(0));
+  EXPECT_NO_THROW(Queue(1));
+}
+
+TEST(MpmcQueueTest, Empty) {
+  // new queues are empty
+  EXPECT_TRUE(Queue(0).empty());
+  EXPECT_TRUE(Queue(1).empty());
+  // max-size 0 queue is always empty
+  EXPECT_TRUE(Queue(0).push(1).empty());
+  // non-empty after push
+  EXPECT_FALSE(Queue(1).push(1).empty());
+  // empty again after pop
+  int dst = 0;
+  Queue q(1);
+  q.push(1);
+  q.pop(dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(MpmcQueueTest, PushPop) {
+  int dst = 0;
+  Queue q(2);
+  q.push(1);
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+
+  q.push(1);
+  q.push(2);
+  q.push(3); // more than max elements. 1 gets popped
+  q.pop(dst);
+  EXPECT_EQ(2, dst);
+  q.pop(dst);
+  EXPECT_EQ(3, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(MpmcQueueTest, TryPop) {
+  int dst = 0;
+  Queue q(1);
+  EXPECT_FALSE(q.try_pop(dst));
+  EXPECT_EQ(0, dst);
+  q.push(1);
+  q.try_pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(MpmcQueueTest, LockingOnEmpty) {
+  Queue q(1);
+  std::future<int> first_pop = std::async(std::launch::async, [&q]() {
+    int i = 0;
+    q.pop(i);
+    return i;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout,status);
+  q.push(5);
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready,status);
+  EXPECT_EQ(5,first_pop.get());
+}
+
+TEST(MpmcQueueTest, Destruction) {
+  std::unique_ptr<Queue> q(new Queue(1));
+  Queue *queue = q.get();
+  std::future<std::pair<bool,int>> first_pop = std::async(std::launch::async, [queue]() {
+    auto result = std::make_pair(true,0);
+    result.first = queue->pop(result.second);
+    return result;
+  });
+  // make sure the queue does not get deleted before the thread waits
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready,status);
+  auto result = first_pop.get();
+  EXPECT_FALSE(result.first);
+  EXPECT_EQ(0,result.second);
+}
+
+TEST(MpmcQueueTest, Contention) {
+  // nothing gets lost or duplicated while there is room for everything
+  const int producers = 4;
+  const int consumers = 4;
+  const int count = 20000;
+  // room for the end markers as well
+  Queue q(producers * count + consumers);
+  std::vector<std::future<std::vector<int>>> popped;
+  for (int c = 0; c < consumers; ++c) {
+    popped.push_back(std::async(std::launch::async, [&q]() {
+      std::vector<int> received;
+      int i = 0;
+      while (q.pop(i) && i >= 0) {
+        received.push_back(i);
+      }
+      return received;
+    }));
+  }
+  std::vector<std::future<void>> pushed;
+  for (int p = 0; p < producers; ++p) {
+    pushed.push_back(std::async(std::launch::async, [&q, p]() {
+      for (int i = 0; i < count; ++i) {
+        q.push(p * count + i);
+      }
+    }));
+  }
+  for (auto &p : pushed) {
+    p.get();
+  }
+  for (int c = 0; c < consumers; ++c) {
+    q.push(-1);
+  }
+  std::vector<int> received(producers * count, 0);
+  for (auto &c : popped) {
+    for (int i : c.get()) {
+      ++received.at(i);
+    }
+  }
+  for (int r : received) {
+    EXPECT_EQ(1, r);
+  }
+}
+
+TEST(MpmcQueueTest, WrapWithoutOverflow) {
+  // the ring wraps many times under contention but producers never fill it,
+  // so nothing may be dropped
+  const int producers = 4;
+  const int consumers = 4;
+  const int count = 20000;
+  const size_t size = 8;
+  Queue q(size);
+  // elements pushed or about to be pushed and not yet popped
+  std::atomic<size_t> queued(0);
+  std::vector<std::future<std::vector<int>>> popped;
+  for (int c = 0; c < consumers; ++c) {
+    popped.push_back(std::async(std::launch::async, [&q, &queued]() {
+      std::vector<int> received;
+      int i = 0;
+      while (q.pop(i) && i >= 0) {
+        --queued;
+        received.push_back(i);
+      }
+      --queued;
+      return received;
+    }));
+  }
+  auto reserve = [&queued, size]() {
+    size_t current = queued.load();
+    for (;;) {
+      if (current < size &&
+          queued.compare_exchange_weak(current, current + 1)) {
+        return;
+      }
+      std::this_thread::yield();
+      current = queued.load();
+    }
+  };
+  std::vector<std::future<void>> pushed;
+  for (int p = 0; p < producers; ++p) {
+    pushed.push_back(std::async(std::launch::async, [&q, &reserve, p]() {
+      for (int i = 0; i < count; ++i) {
+        reserve();
+        q.push(p * count + i);
+      }
+    }));
+  }
+  for (auto &p : pushed) {
+    p.get();
+  }
+  for (int c = 0; c < consumers; ++c) {
+    reserve();
+    q.push(-1);
+  }
+  std::vector<int> received(producers * count, 0);
+  for (auto &c : popped) {
+    for (int i : c.get()) {
+      ++received.at(i);
+    }
+  }
+  for (int r : received) {
+    EXPECT_EQ(1, r);
+  }
+}
+
+TEST(MpmcQueueTest, ContentionWithDrops) {
+  // values may get dropped but never duplicated or reordered per producer
+  const int producers = 4;
+  const int count = 20000;
+  Queue q(8);
+  std::future<std::vector<int>> consumer = std::async(std::launch::async, [&q]() {
+    std::vector<int> received;
+    int i = 0;
+    while (q.pop(i) && i >= 0) {
+      received.push_back(i);
+    }
+    return received;
+  });
+  std::vector<std::future<void>> pushed;
+  for (int p = 0; p < producers; ++p) {
+    pushed.push_back(std::async(std::launch::async, [&q, p]() {
+      for (int i = 0; i < count; ++i) {
+        q.push(p * count + i);
+      }
+    }));
+  }
+  for (auto &p : pushed) {
+    p.get();
+  }
+  while (!q.empty()) {
+    std::this_thread::yield();
+  }
+  q.push(-1);
+  std::vector<int> last(producers, -1);
+  for (int i : consumer.get()) {
+    EXPECT_LT(last.at(i / count), i);
+    last.at(i / count) = i;
+  }
+}
+
+TEST(MpmcQueueTest, ElementLifetime) {
+  // overwritten and remaining elements get destroyed
+  auto element = std::make_shared<int>(1);
+  {
+    ::canon::utils::MpmcQueue<std::shared_ptr<int>> q(2);
+    q.push(element).push(element).push(element);
+    EXPECT_EQ(3, element.use_count());
+  }
+  EXPECT_EQ(1, element.use_count());
+}
+
+TEST(MpmcQueueTest, MoveOnly) {
+  ::canon::utils::MpmcQueue<std::unique_ptr<int>> q(2);
+  q.push(std::unique_ptr<int>(new int(1)));
+  q.emplace(new int(2));
+  q.emplace(new int(3)); // overwrites 1
+  std::unique_ptr<int> dst;
+  EXPECT_TRUE(q.try_pop(dst));
+  EXPECT_EQ(2, *dst);
+  EXPECT_TRUE(q.pop(dst));
+  EXPECT_EQ(3, *dst);
+}
+
+}
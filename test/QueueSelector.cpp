@@ -0,0 +1,180 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/QueueSelector.cpp                                 **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/QueueSelector.h"
+#include "utils/SynchronizedQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+#include <poll.h>
+
+namespace {
+
+typedef ::canon::utils::SynchronizedQueue<int> Queue;
+using ::canon::utils::QueueSelector;
+
+TEST(QueueSelectorTest, Constructor) {
+  EXPECT_NO_THROW(QueueSelector());
+  Queue a(1), b(1);
+  QueueSelector selector;
+  EXPECT_EQ(0u, selector.add(a));
+  EXPECT_EQ(1u, selector.add(b));
+}
+
+TEST(QueueSelectorTest, SelectReady) {
+  Queue a(1), b(2);
+  QueueSelector selector;
+  size_t index_a = selector.add(a);
+  size_t index_b = selector.add(b);
+  size_t ready = 42;
+  EXPECT_FALSE(selector.try_select(ready));
+  b.push(1);
+  EXPECT_TRUE(selector.select(ready));
+  EXPECT_EQ(index_b, ready);
+  // level-triggered: still ready until popped
+  EXPECT_TRUE(selector.try_select(ready));
+  EXPECT_EQ(index_b, ready);
+  int dst = 0;
+  b.pop(dst);
+  EXPECT_FALSE(selector.try_select(ready));
+  // ready queues are served round-robin
+  a.push(1);
+  b.push(2);
+  EXPECT_TRUE(selector.select(ready));
+  size_t first = ready;
+  EXPECT_TRUE(selector.select(ready));
+  EXPECT_NE(first, ready);
+  EXPECT_TRUE(ready == index_a || ready == index_b);
+}
+
+TEST(QueueSelectorTest, DataBeforeAdd) {
+  Queue a(1);
+  a.push(1);
+  QueueSelector selector;
+  size_t index = selector.add(a);
+  size_t ready = 42;
+  EXPECT_TRUE(selector.try_select(ready));
+  EXPECT_EQ(index, ready);
+}
+
+TEST(QueueSelectorTest, LockingOnEmpty) {
+  Queue a(1), b(1);
+  QueueSelector selector;
+  selector.add(a);
+  size_t index_b = selector.add(b);
+  std::future<size_t> selected = std::async(std::launch::async, [&selector]() {
+    size_t ready = 42;
+    selector.select(ready);
+    return ready;
+  });
+  std::future_status status = selected.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  b.push(5);
+  status = selected.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ(index_b, selected.get());
+}
+
+TEST(QueueSelectorTest, SelectFor) {
+  Queue a(1);
+  QueueSelector selector;
+  selector.add(a);
+  size_t ready = 42;
+  EXPECT_FALSE(selector.select_for(ready, std::chrono::milliseconds(5)));
+  a.push(1);
+  EXPECT_TRUE(selector.select_for(ready, std::chrono::milliseconds(5)));
+  EXPECT_EQ(0u, ready);
+}
+
+TEST(QueueSelectorTest, Close) {
+  Queue a(1);
+  QueueSelector selector;
+  selector.add(a);
+  std::future<bool> selected = std::async(std::launch::async, [&selector]() {
+    size_t ready = 42;
+    return selector.select(ready);
+  });
+  std::future_status status = selected.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  selector.close();
+  status = selected.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_FALSE(selected.get());
+}
+
+TEST(QueueSelectorTest, NativeHandle) {
+  Queue a(1);
+  QueueSelector selector;
+  size_t index = selector.add(a);
+  int fd = selector.native_handle();
+  ASSERT_LE(0, fd);
+  pollfd readable = {fd, POLLIN, 0};
+  size_t ready = 42;
+  // initially readable, reset once nothing is ready
+  EXPECT_FALSE(selector.try_select(ready));
+  EXPECT_EQ(0, poll(&readable, 1, 0));
+  a.push(1);
+  EXPECT_EQ(1, poll(&readable, 1, 0));
+  EXPECT_TRUE(selector.try_select(ready));
+  EXPECT_EQ(index, ready);
+}
+
+TEST(QueueSelectorTest, SharedQueue) {
+  Queue a(2);
+  QueueSelector first, second;
+  first.add(a);
+  size_t index = second.add(a);
+  int fd = second.native_handle();
+  ASSERT_LE(0, fd);
+  pollfd readable = {fd, POLLIN, 0};
+  size_t ready = 42;
+  EXPECT_FALSE(first.try_select(ready));
+  EXPECT_FALSE(second.try_select(ready));
+  EXPECT_EQ(0, poll(&readable, 1, 0));
+  // adding the queue to first did not take it away from second
+  a.push(1);
+  EXPECT_EQ(1, poll(&readable, 1, 0));
+  EXPECT_TRUE(second.try_select(ready));
+  EXPECT_EQ(index, ready);
+  EXPECT_TRUE(first.try_select(ready));
+  {
+    QueueSelector third;
+    third.add(a);
+  }
+  // third only removed its own listener
+  int dst = 0;
+  a.pop(dst);
+  EXPECT_FALSE(second.try_select(ready));
+  EXPECT_EQ(0, poll(&readable, 1, 0));
+  a.push(2);
+  EXPECT_EQ(1, poll(&readable, 1, 0));
+}
+
+TEST(QueueSelectorTest, SelectorDestroyedFirst) {
+  Queue a(1);
+  {
+    QueueSelector selector;
+    selector.add(a);
+  }
+  // the queue no longer calls into the selector
+  EXPECT_NO_THROW(a.push(1));
+}
+
+}
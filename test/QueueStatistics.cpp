@@ -0,0 +1,118 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/QueueStatistics.cpp                               **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/QueueStatistics.h"
+#include "utils/SynchronizedQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+using ::canon::utils::DropOldest;
+using ::canon::utils::NoStatistics;
+using ::canon::utils::QueueStatistics;
+
+typedef ::canon::utils::SynchronizedQueue<int, DropOldest, QueueStatistics>
+    Queue;
+
+TEST(QueueStatisticsTest, NoStatisticsIsEmpty) {
+  EXPECT_TRUE(std::is_empty<NoStatistics>::value);
+  EXPECT_TRUE(std::is_empty<NoStatistics::Stamp>::value);
+}
+
+TEST(QueueStatisticsTest, Initial) {
+  Queue q(2);
+  QueueStatistics::Snapshot snapshot = q.statistics().snapshot();
+  EXPECT_EQ(0u, snapshot.pushes);
+  EXPECT_EQ(0u, snapshot.pops);
+  EXPECT_EQ(0u, snapshot.drops);
+  EXPECT_EQ(0u, snapshot.depth);
+  EXPECT_EQ(0u, snapshot.peak_depth);
+  EXPECT_EQ(0u, snapshot.dwell_percentile(0.5));
+}
+
+TEST(QueueStatisticsTest, Counters) {
+  int dst = 0;
+  Queue q(2);
+  q.push(1).push(2).push(3); // 1 gets dropped
+  q.pop(dst);
+  QueueStatistics::Snapshot snapshot = q.statistics().snapshot();
+  EXPECT_EQ(3u, snapshot.pushes);
+  EXPECT_EQ(1u, snapshot.pops);
+  EXPECT_EQ(1u, snapshot.drops);
+  EXPECT_EQ(1u, snapshot.depth);
+  EXPECT_EQ(2u, snapshot.peak_depth);
+}
+
+TEST(QueueStatisticsTest, Bytes) {
+  std::string dst;
+  ::canon::utils::SynchronizedQueue<std::string, DropOldest, QueueStatistics,
+                                    ::canon::utils::NoExpiry,
+                                    ::canon::utils::ByteBound<std::string>>
+      q(::canon::utils::ByteBudget<std::string>(
+          8, [](const std::string &s) { return s.size(); }));
+  q.push("aaa").push("bbbb");
+  q.pop(dst);
+  QueueStatistics::Snapshot snapshot = q.statistics().snapshot();
+  EXPECT_EQ(4u, snapshot.bytes);
+  EXPECT_EQ(7u, snapshot.peak_bytes);
+  EXPECT_EQ(1u, snapshot.depth);
+}
+
+TEST(QueueStatisticsTest, DwellHistogram) {
+  int dst = 0;
+  Queue q(2);
+  q.push(1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  q.pop(dst);
+  QueueStatistics::Snapshot snapshot = q.statistics().snapshot();
+  uint64_t total = 0;
+  for (uint64_t count : snapshot.dwell_histogram) {
+    total += count;
+  }
+  EXPECT_EQ(1u, total);
+  // bucket upper bounds are powers of two nanoseconds
+  EXPECT_LE(2000000u, snapshot.dwell_percentile(1.0));
+}
+
+TEST(QueueStatisticsTest, ConcurrentSnapshot) {
+  Queue q(16);
+  std::atomic<bool> done(false);
+  std::future<uint64_t> reader = std::async(std::launch::async, [&]() {
+    uint64_t last = 0;
+    while (!done.load()) {
+      QueueStatistics::Snapshot snapshot = q.statistics().snapshot();
+      EXPECT_LE(last, snapshot.pushes);
+      last = snapshot.pushes;
+    }
+    return last;
+  });
+  for (int i = 0; i < 10000; ++i) {
+    q.push(i);
+  }
+  done.store(true);
+  EXPECT_LE(reader.get(), 10000u);
+  EXPECT_EQ(10000u, q.statistics().snapshot().pushes);
+}
+
+}
@@ -0,0 +1,103 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/RingBuffer.cpp                                    **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/RingBuffer.h"
+
+#include "gtest/gtest.h"
+
+#include <memory>
+
+namespace {
+
+using ::canon::utils::RingBuffer;
+
+size_t allocations = 0;
+
+template <typename T> struct CountingAllocator : public std::allocator<T> {
+  template <typename U> struct rebind { typedef CountingAllocator<U> other; };
+  CountingAllocator() = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+  T *allocate(size_t n) {
+    ++allocations;
+    return std::allocator<T>::allocate(n);
+  }
+};
+
+TEST(RingBufferTest, Constructor) {
+  EXPECT_NO_THROW(RingBuffer<int>());
+  EXPECT_NO_THROW(RingBuffer<int>(10));
+  EXPECT_EQ(10u, RingBuffer<int>(10).capacity());
+  EXPECT_TRUE(RingBuffer<int>(10).empty());
+}
+
+TEST(RingBufferTest, Fifo) {
+  RingBuffer<int> buffer(3);
+  for (int i = 0; i < 10; ++i) {
+    buffer.push_back(i);
+    if (buffer.size() == 3) {
+      EXPECT_EQ(i - 2, buffer.front());
+      EXPECT_EQ(i - 1, buffer[1]);
+      EXPECT_EQ(i, buffer.back());
+      buffer.pop_front();
+    }
+  }
+  EXPECT_EQ(2u, buffer.size());
+  EXPECT_EQ(8, buffer.front());
+}
+
+TEST(RingBufferTest, Grow) {
+  RingBuffer<int> buffer(2);
+  buffer.push_back(1);
+  buffer.push_back(2);
+  buffer.pop_front();
+  buffer.push_back(3); // wraps around
+  buffer.push_back(4); // grows
+  EXPECT_EQ(4u, buffer.capacity());
+  EXPECT_EQ(3u, buffer.size());
+  EXPECT_EQ(2, buffer[0]);
+  EXPECT_EQ(3, buffer[1]);
+  EXPECT_EQ(4, buffer[2]);
+}
+
+TEST(RingBufferTest, ElementLifetime) {
+  auto element = std::make_shared<int>(1);
+  {
+    RingBuffer<std::shared_ptr<int>> buffer(1);
+    buffer.push_back(element);
+    buffer.push_back(element); // grows
+    EXPECT_EQ(3, element.use_count());
+    buffer.pop_front();
+    EXPECT_EQ(2, element.use_count());
+  }
+  EXPECT_EQ(1, element.use_count());
+}
+
+TEST(RingBufferTest, NoAllocationInSteadyState) {
+  RingBuffer<int, CountingAllocator<int>> buffer(16);
+  allocations = 0;
+  for (int i = 0; i < 1000; ++i) {
+    buffer.push_back(i);
+    if (buffer.size() == 16) {
+      buffer.pop_front();
+    }
+  }
+  EXPECT_EQ(0u, allocations);
+}
+
+}
@@ -0,0 +1,207 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/SharedMemoryQueue.cpp                             **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SharedMemoryQueue.h"
+#include "utils/Exception.h"
+
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using ::canon::utils::SharedMemoryQueue;
+
+class SharedMemoryQueueTest : public ::testing::Test {
+protected:
+  SharedMemoryQueueTest()
+      : name("/canon-test-" + std::to_string(getpid())) {
+    SharedMemoryQueue::remove(name);
+  }
+
+  ~SharedMemoryQueueTest() { SharedMemoryQueue::remove(name); }
+
+  const std::string name;
+};
+
+TEST_F(SharedMemoryQueueTest, Constructor) {
+  EXPECT_THROW(SharedMemoryQueue q(name), canon::utils::Exception);
+  SharedMemoryQueue created(name, 16, 4);
+  SharedMemoryQueue opened(name);
+  EXPECT_EQ(16u, opened.slot_size());
+  EXPECT_EQ(4u, opened.capacity());
+  EXPECT_NO_THROW(SharedMemoryQueue(name, 16, 4));
+  EXPECT_THROW(SharedMemoryQueue(name, 32, 4), canon::utils::Exception);
+}
+
+TEST_F(SharedMemoryQueueTest, PushPop) {
+  SharedMemoryQueue producer(name, 16, 4);
+  SharedMemoryQueue consumer(name);
+  EXPECT_TRUE(consumer.empty());
+  EXPECT_TRUE(producer.push("hello", 5));
+  EXPECT_TRUE(producer.push(42));
+  EXPECT_FALSE(consumer.empty());
+  char buffer[16];
+  size_t size = 0;
+  ASSERT_TRUE(consumer.try_pop(buffer, size));
+  EXPECT_EQ("hello", std::string(buffer, size));
+  int value = 0;
+  ASSERT_TRUE(consumer.pop(value));
+  EXPECT_EQ(42, value);
+  EXPECT_FALSE(consumer.try_pop(buffer, size));
+}
+
+TEST_F(SharedMemoryQueueTest, Oversized) {
+  SharedMemoryQueue q(name, 4, 2);
+  std::vector<char> large(5);
+  EXPECT_FALSE(q.push(large.data(), large.size()));
+  EXPECT_TRUE(q.empty());
+}
+
+TEST_F(SharedMemoryQueueTest, DropOldest) {
+  SharedMemoryQueue q(name, sizeof(int), 2);
+  q.push(1);
+  q.push(2);
+  q.push(3);
+  EXPECT_EQ(1u, q.dropped());
+  int value = 0;
+  q.pop(value);
+  EXPECT_EQ(2, value);
+  q.pop(value);
+  EXPECT_EQ(3, value);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST_F(SharedMemoryQueueTest, Consume) {
+  SharedMemoryQueue q(name, 8, 2);
+  q.push("frame", 5);
+  std::string seen;
+  EXPECT_TRUE(q.try_consume([&seen](const void *data, size_t size) {
+    seen.assign(static_cast<const char *>(data), size);
+  }));
+  EXPECT_EQ("frame", seen);
+  EXPECT_FALSE(q.try_consume([](const void *, size_t) {}));
+}
+
+TEST_F(SharedMemoryQueueTest, SlowConsumer) {
+  SharedMemoryQueue q(name, sizeof(int), 2);
+  std::promise<void> entered;
+  std::promise<void> release;
+  std::future<int> consumer = std::async(std::launch::async, [&]() {
+    int seen = 0;
+    q.consume([&](const void *data, size_t) {
+      std::memcpy(&seen, data, sizeof(int));
+      entered.set_value();
+      release.get_future().wait();
+    });
+    return seen;
+  });
+  q.push(1);
+  entered.get_future().wait();
+  // the producer wraps the ring several times while the consumer is busy
+  std::future<void> producer = std::async(std::launch::async, [&q]() {
+    for (int i = 2; i <= 10; ++i) {
+      q.push(i);
+    }
+  });
+  EXPECT_EQ(std::future_status::ready,
+            producer.wait_for(std::chrono::seconds(5)));
+  release.set_value();
+  EXPECT_EQ(1, consumer.get());
+  EXPECT_EQ(7u, q.dropped());
+  int value = 0;
+  q.pop(value);
+  EXPECT_EQ(9, value);
+}
+
+TEST_F(SharedMemoryQueueTest, CloseDrains) {
+  SharedMemoryQueue q(name, sizeof(int), 4);
+  SharedMemoryQueue other(name);
+  q.push(1);
+  other.close();
+  EXPECT_TRUE(q.closed());
+  EXPECT_FALSE(q.push(2));
+  int value = 0;
+  EXPECT_TRUE(q.pop(value));
+  EXPECT_EQ(1, value);
+  EXPECT_FALSE(q.pop(value));
+}
+
+TEST_F(SharedMemoryQueueTest, LockingOnEmpty) {
+  SharedMemoryQueue q(name, sizeof(int), 4);
+  std::future<int> first_pop = std::async(std::launch::async, [&q]() {
+    int value = 0;
+    q.pop(value);
+    return value;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.push(5);
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ(5, first_pop.get());
+}
+
+TEST_F(SharedMemoryQueueTest, Destruction) {
+  std::unique_ptr<SharedMemoryQueue> q(
+      new SharedMemoryQueue(name, sizeof(int), 4));
+  SharedMemoryQueue *queue = q.get();
+  std::future<bool> first_pop = std::async(std::launch::async, [queue]() {
+    int value = 0;
+    return queue->pop(value);
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  EXPECT_FALSE(first_pop.get());
+}
+
+TEST_F(SharedMemoryQueueTest, AcrossProcesses) {
+  const int count = 10000;
+  SharedMemoryQueue q(name, sizeof(int), 64);
+  pid_t child = fork();
+  ASSERT_LE(0, child);
+  if (child == 0) {
+    SharedMemoryQueue producer(name);
+    for (int i = 1; i <= count; ++i) {
+      producer.push(i);
+    }
+    producer.close();
+    _exit(0);
+  }
+  // elements may get dropped, but the order holds
+  int last = 0;
+  int value = 0;
+  while (q.pop(value)) {
+    ASSERT_LT(last, value);
+    last = value;
+  }
+  EXPECT_EQ(count, last);
+  int status = 0;
+  waitpid(child, &status, 0);
+  EXPECT_EQ(0, status);
+}
+
+}
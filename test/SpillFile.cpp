@@ -0,0 +1,103 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/SpillFile.cpp                                     **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SpillFile.h"
+#include "utils/Exception.h"
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+using ::canon::utils::SpillFile;
+
+std::string spill_path() {
+  return "/tmp/canon-spill-test-" + std::to_string(getpid());
+}
+
+std::string front(const SpillFile &file) {
+  return std::string(file.front(), file.front_size());
+}
+
+TEST(SpillFileTest, Constructor) {
+  EXPECT_NO_THROW(SpillFile(spill_path(), 0));
+  EXPECT_THROW(SpillFile("/nonexistent/directory/spill", 64),
+               canon::utils::Exception);
+  {
+    SpillFile file(spill_path(), 64);
+    EXPECT_EQ(0, access(spill_path().c_str(), F_OK));
+  }
+  // removed again
+  EXPECT_NE(0, access(spill_path().c_str(), F_OK));
+}
+
+TEST(SpillFileTest, Fifo) {
+  SpillFile file(spill_path(), 1024);
+  EXPECT_TRUE(file.empty());
+  EXPECT_TRUE(file.push("first", 5));
+  EXPECT_TRUE(file.push("second", 6));
+  EXPECT_EQ(2u, file.size());
+  EXPECT_EQ("first", front(file));
+  file.pop();
+  EXPECT_EQ("second", front(file));
+  file.pop();
+  EXPECT_TRUE(file.empty());
+  EXPECT_EQ(0u, file.bytes());
+}
+
+TEST(SpillFileTest, Capacity) {
+  // every record takes 8 header bytes and its size rounded up to 8
+  SpillFile file(spill_path(), 48);
+  EXPECT_TRUE(file.push("0123456789", 10));   // 24 bytes
+  EXPECT_TRUE(file.push("0123456789", 10));   // 48 bytes
+  EXPECT_FALSE(file.push("x", 1));
+  EXPECT_EQ(48u, file.bytes());
+  file.pop();
+  EXPECT_TRUE(file.push("x", 1));
+}
+
+TEST(SpillFileTest, WrapAround) {
+  SpillFile file(spill_path(), 64);
+  int next_push = 0;
+  int next_pop = 0;
+  // records of varying size force wraps at different offsets
+  for (int round = 0; round < 100; ++round) {
+    std::string record(1 + round % 13, 'a' + next_push % 26);
+    if (file.push(record.data(), record.size())) {
+      ++next_push;
+    }
+    if (round % 3 != 0 && !file.empty()) {
+      EXPECT_EQ(std::string(1, 'a' + next_pop % 26), front(file).substr(0, 1));
+      file.pop();
+      ++next_pop;
+    }
+    EXPECT_LE(file.bytes(), file.capacity());
+  }
+  while (!file.empty()) {
+    EXPECT_EQ(std::string(1, 'a' + next_pop % 26), front(file).substr(0, 1));
+    file.pop();
+    ++next_pop;
+  }
+  EXPECT_EQ(next_push, next_pop);
+}
+
+}
@@ -0,0 +1,162 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/SpscQueue.cpp                                     **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SpscQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+
+namespace {
+
+typedef ::canon::utils::SpscQueue<int> Queue;
+
+TEST(SpscQueueTest, Constructor) {
+  // constructor does not throw
+  EXPECT_NO_THROW(Queue(0));
+  EXPECT_NO_THROW(Queue(1));
+}
+
+TEST(SpscQueueTest, Empty) {
+  // new queues are empty
+  EXPECT_TRUE(Queue(0).empty());
+  EXPECT_TRUE(Queue(1).empty());
+  // max-size 0 queue is always empty
+  EXPECT_TRUE(Queue(0).push(1).empty());
+  // non-empty after push
+  EXPECT_FALSE(Queue(1).push(1).empty());
+  // empty again after pop
+  int dst = 0;
+  Queue q(1);
+  q.push(1);
+  q.pop(dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueueTest, PushPop) {
+  int dst = 0;
+  Queue q(2);
+  q.push(1);
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+
+  q.push(1);
+  q.push(2);
+  q.push(3); // more than max elements. 1 gets popped
+  q.pop(dst);
+  EXPECT_EQ(2, dst);
+  q.pop(dst);
+  EXPECT_EQ(3, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueueTest, TryPop) {
+  int dst = 0;
+  Queue q(1);
+  EXPECT_FALSE(q.try_pop(dst));
+  EXPECT_EQ(0, dst);
+  q.push(1);
+  q.try_pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SpscQueueTest, LockingOnEmpty) {
+  Queue q(1);
+  std::future<int> first_pop = std::async(std::launch::async, [&q]() {
+    int i = 0;
+    q.pop(i);
+    return i;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout,status);
+  q.push(5);
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready,status);
+  EXPECT_EQ(5,first_pop.get());
+}
+
+TEST(SpscQueueTest, Destruction) {
+  std::unique_ptr<Queue> q(new Queue(1));
+  Queue *queue = q.get();
+  std::future<std::pair<bool,int>> first_pop = std::async(std::launch::async, [queue]() {
+    auto result = std::make_pair(true,0);
+    result.first = queue->pop(result.second);
+    return result;
+  });
+  // make sure the queue does not get deleted before the thread waits
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready,status);
+  auto result = first_pop.get();
+  EXPECT_FALSE(result.first);
+  EXPECT_EQ(0,result.second);
+}
+
+TEST(SpscQueueTest, ConcurrentOrder) {
+  // values may get dropped but never reordered or duplicated
+  const int count = 100000;
+  Queue q(16);
+  std::future<std::vector<int>> consumer = std::async(std::launch::async, [&q]() {
+    std::vector<int> received;
+    int i = -1;
+    while (i != count - 1) {
+      q.pop(i);
+      received.push_back(i);
+    }
+    return received;
+  });
+  for (int i = 0; i < count; ++i) {
+    q.push(i);
+  }
+  auto received = consumer.get();
+  ASSERT_FALSE(received.empty());
+  for (size_t i = 1; i < received.size(); ++i) {
+    EXPECT_LT(received[i - 1], received[i]);
+  }
+  EXPECT_EQ(count - 1, received.back());
+}
+
+TEST(SpscQueueTest, ElementLifetime) {
+  // overwritten and remaining elements get destroyed
+  auto element = std::make_shared<int>(1);
+  {
+    ::canon::utils::SpscQueue<std::shared_ptr<int>> q(2);
+    q.push(element).push(element).push(element);
+    EXPECT_EQ(3, element.use_count());
+  }
+  EXPECT_EQ(1, element.use_count());
+}
+
+TEST(SpscQueueTest, MoveOnly) {
+  ::canon::utils::SpscQueue<std::unique_ptr<int>> q(2);
+  q.push(std::unique_ptr<int>(new int(1)));
+  q.emplace(new int(2));
+  q.emplace(new int(3)); // overwrites 1
+  std::unique_ptr<int> dst;
+  EXPECT_TRUE(q.try_pop(dst));
+  EXPECT_EQ(2, *dst);
+  EXPECT_TRUE(q.pop(dst));
+  EXPECT_EQ(3, *dst);
+}
+
+}
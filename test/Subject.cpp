@@ -21,6 +21,8 @@
 
 #include "gtest/gtest.h"
 
+#include <functional>
+
 namespace {
 
 typedef ::canon::utils::Subject<int> Subject;
@@ -32,6 +34,15 @@ public:
   void update(int new_data) { history.push_back(new_data); }
 };
 
+// counts how often it gets copied
+struct Payload {
+  static size_t copies;
+  Payload() = default;
+  Payload(const Payload &) { ++copies; }
+  Payload(Payload &&) = default;
+};
+size_t Payload::copies = 0;
+
 TEST(SubjectTest, Constructor) {
   EXPECT_NO_THROW(Subject());
   EXPECT_NO_THROW(CompositeSubject({std::make_shared<Subject>(),
@@ -107,5 +118,123 @@ TEST(SubjectTest, DeleteSubject) {
   EXPECT_FALSE(connection.connected());
 }
 
+TEST(SubjectTest, ConstReference) {
+  ::canon::utils::Subject<Payload> subject;
+  int calls = 0;
+  subject.connect_ref([&calls](const Payload &) { ++calls; });
+  subject.connect_ref([&calls](const Payload &) { ++calls; });
+  Payload payload;
+  Payload::copies = 0;
+  subject.notify_ref(payload);
+  subject.notify(Payload());
+  EXPECT_EQ(4, calls);
+  EXPECT_EQ(0u, Payload::copies);
+}
+
+TEST(SubjectTest, ValueSubscribersGetCopies) {
+  ::canon::utils::Subject<Payload> subject;
+  subject.connect([](Payload) {});
+  subject.connect_ref([](const Payload &) {});
+  subject.connect([](Payload) {});
+  Payload payload;
+  Payload::copies = 0;
+  subject.notify_ref(payload);
+  EXPECT_EQ(2u, Payload::copies);
+}
+
+TEST(SubjectTest, NotifyAddress) {
+  Subject subject;
+  Subscriber subscriber;
+  subject.connect([&subscriber](int data) { subscriber.update(data); });
+  // notify is not overloaded, callers may take its address
+  void (Subject::*notify)(int) = &Subject::notify;
+  (subject.*notify)(1);
+  std::function<void(int)> bound =
+      std::bind(&Subject::notify, &subject, std::placeholders::_1);
+  bound(2);
+  EXPECT_EQ(std::vector<int>({1, 2}), subscriber.history);
+}
+
+TEST(SubjectTest, SharedSubject) {
+  ::canon::utils::SharedSubject<std::vector<int>> subject;
+  std::shared_ptr<const std::vector<int>> kept;
+  const std::vector<int> *seen = nullptr;
+  subject.connect([&kept](std::shared_ptr<const std::vector<int>> data) {
+    kept = data;
+  });
+  subject.connect_ref(
+      [&seen](const std::shared_ptr<const std::vector<int>> &data) {
+        seen = data.get();
+      });
+  auto payload = std::make_shared<const std::vector<int>>(1000, 1);
+  subject.notify(payload);
+  // everybody saw the same payload
+  EXPECT_EQ(payload.get(), kept.get());
+  EXPECT_EQ(payload.get(), seen);
+}
+
+TEST(SubjectTest, Merged) {
+  auto a = std::make_shared<Subject>();
+  auto b = std::make_shared<Subject>();
+  ::canon::utils::MergedSubject<int> merged({a, b});
+  EXPECT_EQ(2u, merged.size());
+  Subscriber subscriber;
+  auto connection =
+      merged.connect([&subscriber](int data) { subscriber.update(data); });
+  EXPECT_TRUE(connection.connected());
+  a->notify(1);
+  b->notify(2);
+  EXPECT_EQ(std::vector<int>({1, 2}), subscriber.history);
+  merged.disconnect(connection);
+  EXPECT_FALSE(connection.connected());
+  a->notify(3);
+  EXPECT_EQ(2u, subscriber.history.size());
+}
+
+TEST(SubjectTest, MergedAddRemove) {
+  auto a = std::make_shared<Subject>();
+  auto b = std::make_shared<Subject>();
+  ::canon::utils::MergedSubject<int> merged;
+  Subscriber subscriber;
+  merged.connect([&subscriber](int data) { subscriber.update(data); });
+  a->notify(1);
+  // subscribers follow sources that come and go
+  merged.add(a);
+  merged.add(b);
+  a->notify(2);
+  b->notify(3);
+  merged.remove(a);
+  EXPECT_EQ(1u, merged.size());
+  a->notify(4);
+  b->notify(5);
+  EXPECT_EQ(std::vector<int>({2, 3, 5}), subscriber.history);
+}
 
+TEST(SubjectTest, MergedWithoutCopies) {
+  auto a = std::make_shared<::canon::utils::Subject<Payload>>();
+  auto b = std::make_shared<::canon::utils::Subject<Payload>>();
+  ::canon::utils::MergedSubject<Payload> merged({a, b});
+  int calls = 0;
+  merged.connect_ref([&calls](const Payload &) { ++calls; });
+  Payload payload;
+  Payload::copies = 0;
+  a->notify_ref(payload);
+  b->notify_ref(payload);
+  EXPECT_EQ(2, calls);
+  EXPECT_EQ(0u, Payload::copies);
+}
+
+TEST(SubjectTest, DeleteMerged) {
+  auto a = std::make_shared<Subject>();
+  std::unique_ptr<::canon::utils::MergedSubject<int>> merged(
+      new ::canon::utils::MergedSubject<int>({a}));
+  Subscriber subscriber;
+  auto connection =
+      merged->connect([&subscriber](int data) { subscriber.update(data); });
+  merged.reset();
+  EXPECT_FALSE(connection.connected());
+  EXPECT_NO_THROW(connection.disconnect());
+  a->notify(1);
+  EXPECT_TRUE(subscriber.history.empty());
+}
 }
@@ -0,0 +1,103 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/SynchronizedPriorityQueue.cpp                     **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/SynchronizedPriorityQueue.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+#include <string>
+
+namespace {
+
+typedef ::canon::utils::SynchronizedPriorityQueue<std::string> Queue;
+
+TEST(SynchronizedPriorityQueueTest, Constructor) {
+  EXPECT_NO_THROW(Queue(0));
+  EXPECT_NO_THROW(Queue(1));
+}
+
+TEST(SynchronizedPriorityQueueTest, Empty) {
+  EXPECT_TRUE(Queue(0).empty());
+  EXPECT_TRUE(Queue(0).push(1, "a").empty());
+  EXPECT_FALSE(Queue(1).push(1, "a").empty());
+}
+
+TEST(SynchronizedPriorityQueueTest, PopOrder) {
+  std::string dst;
+  Queue q(10);
+  q.push(1, "telemetry 1").push(5, "safety 1").push(1, "telemetry 2");
+  q.push(5, "safety 2").push(3, "status");
+  for (auto expected : {"safety 1", "safety 2", "status", "telemetry 1",
+                        "telemetry 2"}) {
+    ASSERT_TRUE(q.try_pop(dst));
+    EXPECT_EQ(expected, dst);
+  }
+  EXPECT_FALSE(q.try_pop(dst));
+}
+
+TEST(SynchronizedPriorityQueueTest, EvictLowestOldest) {
+  std::string dst;
+  Queue q(3);
+  q.push(1, "telemetry 1").push(1, "telemetry 2").push(5, "safety 1");
+  q.push(5, "safety 2"); // telemetry 1 gets dropped
+  EXPECT_EQ(1u, q.dropped());
+  q.push(0, "debug"); // lower than everything queued, gets dropped
+  EXPECT_EQ(2u, q.dropped());
+  EXPECT_EQ(3u, q.size());
+  q.pop(dst);
+  EXPECT_EQ("safety 1", dst);
+  q.pop(dst);
+  EXPECT_EQ("safety 2", dst);
+  q.pop(dst);
+  EXPECT_EQ("telemetry 2", dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedPriorityQueueTest, LockingOnEmpty) {
+  Queue q(1);
+  std::future<std::string> first_pop = std::async(std::launch::async, [&q]() {
+    std::string s;
+    q.pop(s);
+    return s;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.push(1, "a");
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ("a", first_pop.get());
+}
+
+TEST(SynchronizedPriorityQueueTest, Destruction) {
+  std::unique_ptr<Queue> q(new Queue(1));
+  Queue *queue = q.get();
+  std::future<bool> first_pop = std::async(std::launch::async, [queue]() {
+    std::string s;
+    return queue->pop(s);
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_FALSE(first_pop.get());
+}
+
+}
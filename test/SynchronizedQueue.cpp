@@ -21,7 +21,15 @@
 
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <cstring>
 #include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include <unistd.h>
 
 namespace {
 
@@ -111,4 +119,590 @@ TEST(SynchronizedQueueTest, Destruction) {
   EXPECT_EQ(0,result.second);
 }
 
+TEST(SynchronizedQueueTest, MoveOnly) {
+  ::canon::utils::SynchronizedQueue<std::unique_ptr<int>> q(2);
+  q.push(std::unique_ptr<int>(new int(1)));
+  q.emplace(new int(2));
+  std::unique_ptr<int> dst;
+  EXPECT_TRUE(q.try_pop(dst));
+  EXPECT_EQ(1, *dst);
+  EXPECT_TRUE(q.pop(dst));
+  EXPECT_EQ(2, *dst);
+}
+
+struct Counted {
+  static int copies;
+  Counted() = default;
+  Counted(const Counted &) { ++copies; }
+  Counted(Counted &&) = default;
+  Counted &operator=(const Counted &) { ++copies; return *this; }
+  Counted &operator=(Counted &&) = default;
+};
+int Counted::copies = 0;
+
+TEST(SynchronizedQueueTest, NoCopies) {
+  ::canon::utils::SynchronizedQueue<Counted> q(1);
+  Counted dst;
+  Counted::copies = 0;
+  q.push(Counted());
+  q.pop(dst);
+  q.emplace();
+  q.try_pop(dst);
+  EXPECT_EQ(0, Counted::copies);
+  // lvalues are copied exactly once on the way in
+  q.push(dst);
+  q.pop(dst);
+  EXPECT_EQ(1, Counted::copies);
+}
+
+TEST(SynchronizedQueueTest, PushRange) {
+  std::vector<int> values = {1, 2, 3};
+  int dst = 0;
+  Queue q(2);
+  q.push_range(values.begin(), values.end()); // 1 gets popped
+  q.pop(dst);
+  EXPECT_EQ(2, dst);
+  q.pop(dst);
+  EXPECT_EQ(3, dst);
+  EXPECT_TRUE(q.empty());
+  EXPECT_TRUE(Queue(0).push_range(values.begin(), values.end()).empty());
+}
+
+TEST(SynchronizedQueueTest, PopBulk) {
+  std::vector<int> values = {1, 2, 3};
+  std::vector<int> dst;
+  Queue q(3);
+  q.push_range(values.begin(), values.end());
+  EXPECT_EQ(2u, q.pop_bulk(std::back_inserter(dst), 2));
+  EXPECT_EQ(1u, q.pop_bulk(std::back_inserter(dst), 2));
+  EXPECT_EQ(values, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, Drain) {
+  std::vector<int> values = {1, 2, 3};
+  std::vector<int> dst = {0};
+  Queue q(3);
+  q.push_range(values.begin(), values.end());
+  EXPECT_TRUE(q.drain(dst));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3}), dst);
+  EXPECT_TRUE(q.empty());
+  // the queue keeps working after a drain
+  q.push(4);
+  EXPECT_FALSE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, DrainLockingOnEmpty) {
+  Queue q(2);
+  std::future<std::vector<int>> drained = std::async(std::launch::async, [&q]() {
+    std::vector<int> result;
+    q.drain(result);
+    return result;
+  });
+  std::future_status status = drained.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout,status);
+  q.push(5);
+  status = drained.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready,status);
+  EXPECT_EQ(std::vector<int>({5}),drained.get());
+}
+
+TEST(SynchronizedQueueTest, DropOldest) {
+  int dst = 0;
+  Queue q(1);
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push(1));
+  EXPECT_EQ(canon::utils::PushStatus::DroppedOldest, q.try_push(2));
+  EXPECT_EQ(1u, q.dropped());
+  q.pop(dst);
+  EXPECT_EQ(2, dst);
+}
+
+TEST(SynchronizedQueueTest, DropNewest) {
+  int dst = 0;
+  canon::utils::SynchronizedQueue<int, canon::utils::DropNewest> q(1);
+  q.push(1).push(2);
+  EXPECT_EQ(canon::utils::PushStatus::DroppedNewest, q.try_push(3));
+  EXPECT_EQ(2u, q.dropped());
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, Reject) {
+  int dst = 0;
+  std::vector<int> values = {2, 3};
+  canon::utils::SynchronizedQueue<int, canon::utils::Reject> q(1);
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push(1));
+  EXPECT_EQ(canon::utils::PushStatus::Rejected, q.try_push(2));
+  q.push_range(values.begin(), values.end());
+  EXPECT_EQ(3u, q.dropped());
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, BlockProducer) {
+  typedef canon::utils::SynchronizedQueue<int, canon::utils::BlockProducer>
+      BlockingQueue;
+  BlockingQueue q(1);
+  q.push(1);
+  std::future<canon::utils::PushStatus> second_push = std::async(
+      std::launch::async, [&q]() { return q.try_push(2); });
+  std::future_status status = second_push.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  int dst = 0;
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  status = second_push.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, second_push.get());
+  q.pop(dst);
+  EXPECT_EQ(2, dst);
+  EXPECT_EQ(0u, q.dropped());
+}
+
+TEST(SynchronizedQueueTest, BlockProducerTimeout) {
+  canon::utils::SynchronizedQueue<int, canon::utils::BlockProducer> q(
+      1, canon::utils::BlockProducer(std::chrono::milliseconds(5)));
+  q.push(1);
+  EXPECT_EQ(canon::utils::PushStatus::Timeout, q.try_push(2));
+  EXPECT_EQ(1u, q.dropped());
+  int dst = 0;
+  q.pop(dst);
+  EXPECT_EQ(1, dst);
+  EXPECT_TRUE(q.empty());
+}
+
+std::atomic<size_t> allocations(0);
+std::atomic<size_t> allocated_bytes(0);
+
+template <typename T> struct CountingAllocator : public std::allocator<T> {
+  template <typename U> struct rebind { typedef CountingAllocator<U> other; };
+  CountingAllocator() = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+  T *allocate(size_t n) {
+    ++allocations;
+    allocated_bytes += n * sizeof(T);
+    return std::allocator<T>::allocate(n);
+  }
+};
+
+TEST(SynchronizedQueueTest, NoAllocationInSteadyState) {
+  using canon::utils::DropOldest;
+  using canon::utils::NoExpiry;
+  using canon::utils::NoStatistics;
+  canon::utils::SynchronizedQueue<int, DropOldest, NoStatistics, NoExpiry,
+                                  canon::utils::CountBound,
+                                  CountingAllocator<int>>
+      q(4);
+  std::vector<int> values = {1, 2, 3};
+  std::vector<int> dst;
+  dst.reserve(4);
+  int i = 0;
+  allocations = 0;
+  for (int round = 0; round < 1000; ++round) {
+    q.push(round).push(round).push(round).push(round).push(round);
+    q.pop(i);
+    q.try_pop(i);
+    q.push_range(values.begin(), values.end());
+    dst.clear();
+    q.drain(dst);
+  }
+  EXPECT_EQ(0u, allocations);
+}
+
+TEST(SynchronizedQueueTest, PopFor) {
+  using canon::utils::PopStatus;
+  int dst = 0;
+  Queue q(1);
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_EQ(PopStatus::Timeout, q.pop_for(dst, std::chrono::milliseconds(10)));
+  EXPECT_LE(std::chrono::milliseconds(10), std::chrono::steady_clock::now() - start);
+  EXPECT_EQ(0, dst);
+  q.push(1);
+  EXPECT_EQ(PopStatus::Popped, q.pop_for(dst, std::chrono::milliseconds(10)));
+  EXPECT_EQ(1, dst);
+}
+
+TEST(SynchronizedQueueTest, PopUntilLockingOnEmpty) {
+  using canon::utils::PopStatus;
+  Queue q(1);
+  std::future<std::pair<PopStatus,int>> first_pop = std::async(std::launch::async, [&q]() {
+    auto result = std::make_pair(PopStatus::Timeout,0);
+    result.first = q.pop_until(result.second, std::chrono::steady_clock::now() +
+                                                  std::chrono::seconds(10));
+    return result;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout,status);
+  q.push(5);
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready,status);
+  auto result = first_pop.get();
+  EXPECT_EQ(PopStatus::Popped,result.first);
+  EXPECT_EQ(5,result.second);
+}
+
+TEST(SynchronizedQueueTest, PopForDestruction) {
+  using canon::utils::PopStatus;
+  std::unique_ptr<Queue> q(new Queue(1));
+  Queue *queue = q.get();
+  std::future<PopStatus> first_pop = std::async(std::launch::async, [queue]() {
+    int i = 0;
+    return queue->pop_for(i, std::chrono::seconds(10));
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready,status);
+  EXPECT_EQ(PopStatus::Shutdown,first_pop.get());
+}
+
+TEST(SynchronizedQueueTest, AdaptiveWait) {
+  Queue q(1, canon::utils::DropOldest(),
+          canon::utils::WaitStrategy::adaptive(100, 10));
+  std::future<int> first_pop = std::async(std::launch::async, [&q]() {
+    int i = 0;
+    q.pop(i);
+    return i;
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout,status);
+  q.push(5);
+  status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::ready,status);
+  EXPECT_EQ(5,first_pop.get());
+  // spinning consumers see data pushed while they spin
+  std::future<int> second_pop = std::async(std::launch::async, [&q]() {
+    int i = 0;
+    q.pop(i);
+    return i;
+  });
+  q.push(6);
+  EXPECT_EQ(6,second_pop.get());
+}
+
+typedef canon::utils::ByteBudget<std::string> StringBudget;
+
+template <typename Overflow>
+using StringBytesQueue =
+    canon::utils::SynchronizedQueue<std::string, Overflow,
+                                    canon::utils::NoStatistics,
+                                    canon::utils::NoExpiry,
+                                    canon::utils::ByteBound<std::string>>;
+
+size_t string_size(const std::string &s) { return s.size(); }
+
+TEST(SynchronizedQueueTest, CountBoundIsEmpty) {
+  // count bounded queues carry no size function
+  EXPECT_TRUE(std::is_empty<canon::utils::CountBound>::value);
+}
+
+TEST(SynchronizedQueueTest, CountBoundSlots) {
+  allocated_bytes = 0;
+  canon::utils::SynchronizedQueue<
+      int, canon::utils::DropOldest, canon::utils::NoStatistics,
+      canon::utils::NoExpiry, canon::utils::CountBound, CountingAllocator<int>>
+      q(4);
+  // the elements carry no weight, their count is the load
+  EXPECT_EQ(4 * sizeof(int), allocated_bytes.load());
+  q.set_watermarks(2, 0);
+  q.push(1).push(2);
+  EXPECT_TRUE(q.above_watermark());
+}
+
+TEST(SynchronizedQueueTest, ByteBudgetDropOldest) {
+  std::string dst;
+  StringBytesQueue<canon::utils::DropOldest> q(StringBudget(10, string_size));
+  q.push("aaa").push("bbb").push("ccc");
+  // needs room for 6 bytes, the two oldest elements go
+  EXPECT_EQ(canon::utils::PushStatus::DroppedOldest,
+            q.try_push(std::string(6, 'd')));
+  EXPECT_EQ(2u, q.dropped());
+  // larger than the whole budget
+  EXPECT_EQ(canon::utils::PushStatus::Rejected,
+            q.try_push(std::string(11, 'e')));
+  q.emplace(1, 'f');
+  q.pop(dst);
+  EXPECT_EQ("ccc", dst);
+  q.pop(dst);
+  EXPECT_EQ("dddddd", dst);
+  q.pop(dst);
+  EXPECT_EQ("f", dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, ByteBudgetReject) {
+  std::string dst;
+  StringBytesQueue<canon::utils::Reject> q(StringBudget(4, string_size));
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push("aaa"));
+  EXPECT_EQ(canon::utils::PushStatus::Rejected, q.try_push("bb"));
+  // small elements still fit
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push("c"));
+  q.pop(dst);
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push("bb"));
+}
+
+TEST(SynchronizedQueueTest, CloseDrains) {
+  int dst = 0;
+  Queue q(3);
+  q.push(1).push(2);
+  EXPECT_FALSE(q.closed());
+  q.close();
+  EXPECT_TRUE(q.closed());
+  EXPECT_EQ(canon::utils::PushStatus::Closed, q.try_push(3));
+  EXPECT_EQ(0u, q.dropped());
+  // queued elements are still delivered
+  EXPECT_TRUE(q.pop(dst));
+  EXPECT_EQ(1, dst);
+  EXPECT_EQ(canon::utils::PopStatus::Popped,
+            q.pop_for(dst, std::chrono::milliseconds(1)));
+  EXPECT_EQ(2, dst);
+  EXPECT_FALSE(q.pop(dst));
+  EXPECT_EQ(canon::utils::PopStatus::Shutdown,
+            q.pop_for(dst, std::chrono::milliseconds(1)));
+}
+
+TEST(SynchronizedQueueTest, CloseWakesConsumer) {
+  Queue q(1);
+  std::future<bool> first_pop = std::async(std::launch::async, [&q]() {
+    int i = 0;
+    return q.pop(i);
+  });
+  std::future_status status = first_pop.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.close();
+  status = first_pop.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_FALSE(first_pop.get());
+}
+
+TEST(SynchronizedQueueTest, CloseWakesProducer) {
+  canon::utils::SynchronizedQueue<int, canon::utils::BlockProducer> q(1);
+  q.push(1);
+  std::future<canon::utils::PushStatus> second_push = std::async(
+      std::launch::async, [&q]() { return q.try_push(2); });
+  std::future_status status = second_push.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.close();
+  status = second_push.wait_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(std::future_status::ready, status);
+  EXPECT_EQ(canon::utils::PushStatus::Closed, second_push.get());
+  int dst = 0;
+  EXPECT_TRUE(q.pop(dst));
+  EXPECT_EQ(1, dst);
+}
+
+TEST(SynchronizedQueueTest, DestructionWithBlockedProducer) {
+  typedef canon::utils::SynchronizedQueue<int, canon::utils::BlockProducer>
+      BlockingQueue;
+  std::unique_ptr<BlockingQueue> q(new BlockingQueue(1));
+  BlockingQueue *queue = q.get();
+  queue->push(1);
+  std::future<canon::utils::PushStatus> second_push = std::async(
+      std::launch::async, [queue]() { return queue->try_push(2); });
+  std::future_status status = second_push.wait_for(std::chrono::milliseconds(10));
+  EXPECT_EQ(std::future_status::timeout, status);
+  q.reset();
+  EXPECT_EQ(canon::utils::PushStatus::Closed, second_push.get());
+}
+
+typedef canon::utils::SpillToDisk<int> IntSpill;
+
+IntSpill int_spill(size_t max_bytes) {
+  return IntSpill("/tmp/canon-queue-spill-" + std::to_string(getpid()),
+                  max_bytes,
+                  [](const int &value, std::vector<char> &buffer) {
+                    const char *bytes = reinterpret_cast<const char *>(&value);
+                    buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+                  },
+                  [](const char *bytes, size_t) {
+                    int value;
+                    std::memcpy(&value, bytes, sizeof(value));
+                    return value;
+                  });
+}
+
+TEST(SynchronizedQueueTest, SpillToDisk) {
+  IntSpill spill = int_spill(4096);
+  canon::utils::SynchronizedQueue<int, IntSpill> q(2, spill);
+  EXPECT_EQ(canon::utils::PushStatus::Pushed, q.try_push(0));
+  q.push(1);
+  EXPECT_EQ(canon::utils::PushStatus::Spilled, q.try_push(2));
+  std::vector<int> values = {3, 4, 5};
+  q.push_range(values.begin(), values.end());
+  q.emplace(6);
+  EXPECT_EQ(5u, spill.spilled());
+  EXPECT_EQ(0u, q.dropped());
+  // comes back in order
+  for (int i = 0; i < 7; ++i) {
+    int dst = -1;
+    ASSERT_TRUE(q.try_pop(dst));
+    EXPECT_EQ(i, dst);
+  }
+  EXPECT_TRUE(q.empty());
+  EXPECT_EQ(0u, spill.spilled());
+}
+
+TEST(SynchronizedQueueTest, SpillToDiskCapped) {
+  // room for two records of 8 header, 8 weight and 8 padded int bytes
+  IntSpill spill = int_spill(48);
+  canon::utils::SynchronizedQueue<int, IntSpill> q(1, spill);
+  q.push(0).push(1).push(2);
+  EXPECT_EQ(canon::utils::PushStatus::Rejected, q.try_push(3));
+  EXPECT_EQ(1u, q.dropped());
+  std::vector<int> dst;
+  q.drain(dst);
+  q.drain(dst);
+  q.drain(dst);
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), dst);
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, SpillToDiskConcurrent) {
+  const int count = 100000;
+  canon::utils::SynchronizedQueue<int, IntSpill> q(64, int_spill(1 << 22));
+  std::future<bool> consumer = std::async(std::launch::async, [&q]() {
+    for (int i = 0; i < count; ++i) {
+      int dst = -1;
+      if (!q.pop(dst) || dst != i) {
+        return false;
+      }
+    }
+    return true;
+  });
+  for (int i = 0; i < count; ++i) {
+    q.push(i);
+  }
+  EXPECT_TRUE(consumer.get());
+  EXPECT_EQ(0u, q.dropped());
+}
+
+// a clock tests move by hand
+struct ManualClock {
+  typedef std::chrono::nanoseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<ManualClock> time_point;
+  static const bool is_steady = true;
+
+  static time_point now() { return current; }
+  static time_point current;
+};
+
+ManualClock::time_point ManualClock::current;
+
+typedef canon::utils::SynchronizedQueue<
+    int, canon::utils::DropOldest, canon::utils::NoStatistics,
+    canon::utils::TimeToLive<ManualClock>>
+    ExpiringQueue;
+
+ExpiringQueue::ExpiryPolicy ttl(int ms) {
+  return ExpiringQueue::ExpiryPolicy(std::chrono::milliseconds(ms));
+}
+
+TEST(SynchronizedQueueTest, TimeToLive) {
+  int dst = 0;
+  ExpiringQueue q(10, canon::utils::DropOldest(),
+                  canon::utils::WaitStrategy::blocking(), ttl(100));
+  q.push(1).push(2);
+  ManualClock::current += std::chrono::milliseconds(60);
+  q.push(3);
+  ManualClock::current += std::chrono::milliseconds(60);
+  // 1 and 2 are 120ms old
+  ASSERT_TRUE(q.try_pop(dst));
+  EXPECT_EQ(3, dst);
+  EXPECT_EQ(2u, q.expired());
+  EXPECT_EQ(0u, q.dropped());
+  q.push(4);
+  ManualClock::current += std::chrono::milliseconds(100);
+  EXPECT_FALSE(q.try_pop(dst));
+  EXPECT_EQ(3u, q.expired());
+  EXPECT_TRUE(q.empty());
+}
+
+TEST(SynchronizedQueueTest, TimeToLiveBulk) {
+  ExpiringQueue q(10, canon::utils::DropOldest(),
+                  canon::utils::WaitStrategy::blocking(), ttl(100));
+  q.push(1).push(2);
+  ManualClock::current += std::chrono::milliseconds(100);
+  q.push(3).push(4);
+  std::vector<int> dst;
+  EXPECT_TRUE(q.drain(dst));
+  EXPECT_EQ(std::vector<int>({3, 4}), dst);
+  q.push(5);
+  ManualClock::current += std::chrono::milliseconds(100);
+  EXPECT_EQ(canon::utils::PopStatus::Timeout,
+            q.pop_for(dst.front(), std::chrono::milliseconds(1)));
+  EXPECT_EQ(3u, q.expired());
+}
+
+TEST(SynchronizedQueueTest, TimeToLiveSpilled) {
+  int dst = 0;
+  canon::utils::SynchronizedQueue<int, IntSpill, canon::utils::NoStatistics,
+                                  canon::utils::TimeToLive<ManualClock>>
+      q(1, int_spill(4096), canon::utils::WaitStrategy::blocking(), ttl(10));
+  q.push(0).push(1);
+  ManualClock::current += std::chrono::milliseconds(8);
+  // reads 1 back from disk
+  q.pop(dst);
+  EXPECT_EQ(0, dst);
+  q.push(2);
+  ManualClock::current += std::chrono::milliseconds(4);
+  // 1 expires with the deadline it got when it was pushed
+  ASSERT_TRUE(q.try_pop(dst));
+  EXPECT_EQ(2, dst);
+  EXPECT_EQ(1u, q.expired());
+}
+
+TEST(SynchronizedQueueTest, TimeToLiveEmpty) {
+  ExpiringQueue q(10, canon::utils::DropOldest(),
+                  canon::utils::WaitStrategy::blocking(), ttl(10));
+  q.set_watermarks(2, 0);
+  q.push(1).push(2);
+  EXPECT_FALSE(q.empty());
+  EXPECT_TRUE(q.above_watermark());
+  ManualClock::current += std::chrono::milliseconds(10);
+  // holds only expired elements
+  EXPECT_TRUE(q.empty());
+  // the push drops them
+  q.push(3);
+  EXPECT_FALSE(q.empty());
+  EXPECT_EQ(2u, q.expired());
+  EXPECT_FALSE(q.above_watermark());
+}
+
+TEST(SynchronizedQueueTest, Watermarks) {
+  int dst = 0;
+  std::vector<bool> edges;
+  Queue q(10);
+  q.push(1);
+  q.set_watermarks(3, 1, [&edges](bool above) { edges.push_back(above); });
+  EXPECT_FALSE(q.above_watermark());
+  q.push(2).push(3);
+  EXPECT_TRUE(q.above_watermark());
+  q.push(4);
+  q.pop(dst);
+  q.pop(dst);
+  // hysteresis: stays above until the load falls to the low watermark
+  EXPECT_TRUE(q.above_watermark());
+  q.push(5);
+  q.pop(dst);
+  q.pop(dst);
+  EXPECT_FALSE(q.above_watermark());
+  q.pop(dst);
+  EXPECT_EQ(std::vector<bool>({true, false}), edges);
+}
+
+TEST(SynchronizedQueueTest, WatermarksWithoutCallback) {
+  Queue q(10);
+  q.set_watermarks(2, 0);
+  q.push(1).push(2);
+  EXPECT_TRUE(q.above_watermark());
+  std::vector<int> dst;
+  q.drain(dst);
+  EXPECT_FALSE(q.above_watermark());
+}
+
 }
@@ -0,0 +1,99 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/TripleBuffer.cpp                                  **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/TripleBuffer.h"
+
+#include "gtest/gtest.h"
+
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using ::canon::utils::TripleBuffer;
+
+TEST(TripleBufferTest, Initial) {
+  TripleBuffer<int> buffer(7);
+  EXPECT_FALSE(buffer.updated());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(7, buffer.output());
+}
+
+TEST(TripleBufferTest, LatestWins) {
+  TripleBuffer<int> buffer;
+  buffer.write(1);
+  buffer.write(2);
+  EXPECT_TRUE(buffer.updated());
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(2, buffer.output());
+  // nothing new since the last update
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(2, buffer.output());
+  buffer.input() = 3;
+  buffer.publish();
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(3, buffer.output());
+}
+
+TEST(TripleBufferTest, ReuseBuffers) {
+  TripleBuffer<std::vector<int>> buffer;
+  for (int i = 0; i < 10; ++i) {
+    buffer.input().assign(1000, i);
+    buffer.publish();
+    ASSERT_TRUE(buffer.update());
+    EXPECT_EQ(i, buffer.output().front());
+  }
+  // every buffer went around and kept its storage
+  EXPECT_LE(1000u, buffer.input().capacity());
+}
+
+TEST(TripleBufferTest, MoveOnly) {
+  TripleBuffer<std::unique_ptr<int>> buffer;
+  buffer.write(std::unique_ptr<int>(new int(5)));
+  ASSERT_TRUE(buffer.update());
+  EXPECT_EQ(5, *buffer.output());
+}
+
+TEST(TripleBufferTest, Concurrent) {
+  typedef std::pair<int, int> Frame; // both halves are written separately
+  TripleBuffer<Frame> buffer(Frame(0, 0));
+  const int count = 100000;
+  std::future<bool> consumer = std::async(std::launch::async, [&buffer]() {
+    int last = 0;
+    while (last != count) {
+      if (buffer.update()) {
+        const Frame &frame = buffer.output();
+        if (frame.first != frame.second || frame.first < last) {
+          return false;
+        }
+        last = frame.first;
+      }
+    }
+    return true;
+  });
+  for (int i = 1; i <= count; ++i) {
+    buffer.input().first = i;
+    buffer.input().second = i;
+    buffer.publish();
+  }
+  EXPECT_TRUE(consumer.get());
+}
+
+}
@@ -0,0 +1,103 @@
+/********************************************************************
+**                                                                 **
+** Copyright (C) 2014 Viktor Richter                               **
+**                                                                 **
+** File   : test/UnsynchronizedSignal.cpp                          **
+** Authors: Viktor Richter                                         **
+**                                                                 **
+**                                                                 **
+** GNU LESSER GENERAL PUBLIC LICENSE                               **
+** This file may be used under the terms of the GNU Lesser General **
+** Public License version 3.0 as published by the                  **
+**                                                                 **
+** Free Software Foundation and appearing in the file LICENSE.LGPL **
+** included in the packaging of this file.  Please review the      **
+** following information to ensure the license requirements will   **
+** be met: http://www.gnu.org/licenses/lgpl-3.0.txt                **
+**                                                                 **
+********************************************************************/
+
+#include "utils/Subject.h"
+#include "utils/UnsynchronizedSignal.h"
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+namespace {
+
+using ::canon::utils::Unsynchronized;
+
+typedef ::canon::utils::Subject<int, Unsynchronized> Subject;
+typedef ::canon::utils::CompositeSubject<int, Unsynchronized> CompositeSubject;
+
+TEST(UnsynchronizedSignalTest, Connect) {
+  Subject subject;
+  std::vector<int> history;
+  auto connection = subject.connect([&history](int i) { history.push_back(i); });
+  subject.connect_ref([&history](const int &i) { history.push_back(-i); });
+  EXPECT_TRUE(connection.connected());
+  subject.notify(1);
+  subject.notify(2);
+  EXPECT_EQ(std::vector<int>({1, -1, 2, -2}), history);
+}
+
+TEST(UnsynchronizedSignalTest, Disconnect) {
+  Subject subject;
+  std::vector<int> history;
+  auto first = subject.connect([&history](int i) { history.push_back(i); });
+  auto second = subject.connect([&history](int i) { history.push_back(-i); });
+  subject.notify(1);
+  first.disconnect();
+  EXPECT_FALSE(first.connected());
+  subject.notify(2);
+  subject.disconnect(second);
+  subject.notify(3);
+  EXPECT_EQ(std::vector<int>({1, -1, -2}), history);
+}
+
+TEST(UnsynchronizedSignalTest, DeleteSubject) {
+  Subject::Connection connection;
+  {
+    Subject subject;
+    connection = subject.connect([](int) {});
+  }
+  EXPECT_FALSE(connection.connected());
+  EXPECT_NO_THROW(connection.disconnect());
+}
+
+TEST(UnsynchronizedSignalTest, ChangeWhileNotifying) {
+  Subject subject;
+  std::vector<int> history;
+  Subject::Connection second;
+  Subject::Connection first = subject.connect([&](int i) {
+    history.push_back(i);
+    if (i == 1) {
+      // disconnected subscribers are skipped, new ones wait for the next
+      // notification, even when connected from a nested one
+      second.disconnect();
+      subject.notify(10);
+      subject.connect([&history](int i) { history.push_back(-i); });
+    }
+  });
+  second = subject.connect([&history](int i) { history.push_back(i * 100); });
+  subject.notify(1);
+  subject.notify(2);
+  first.disconnect();
+  subject.notify(3);
+  EXPECT_EQ(std::vector<int>({1, 10, 2, -2, -3}), history);
+}
+
+TEST(UnsynchronizedSignalTest, Composite) {
+  auto a = std::make_shared<Subject>();
+  auto b = std::make_shared<Subject>();
+  CompositeSubject composite({a, b});
+  std::vector<int> history;
+  composite.connect([&history](int i) { history.push_back(i); });
+  a->notify(1);
+  b->notify(2);
+  EXPECT_EQ(std::vector<int>({1, 2}), history);
+}
+
+}